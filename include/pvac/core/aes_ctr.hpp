@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__AES__) && defined(__SSE2__)
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#define PVAC_USE_AESNI 1
+#else
+#define PVAC_USE_AESNI 0
+#endif
+
+namespace pvac {
+
+#if PVAC_USE_AESNI
+
+struct AesCtr256 {
+    __m128i rk[15];
+    __m128i ctr;
+    alignas(16) uint64_t buf[2] = {0, 0};
+    bool has_buf = false;
+
+    static inline __m128i key_expand(__m128i k, __m128i t) {
+        t = _mm_shuffle_epi32(t, 0xFF);
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        return _mm_xor_si128(k, t);
+    }
+
+    static inline __m128i key_expand2(__m128i k1, __m128i k2) {
+        __m128i t = _mm_aeskeygenassist_si128(k2, 0);
+        t = _mm_shuffle_epi32(t, 0xAA);
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        return _mm_xor_si128(k1, t);
+    }
+
+    void init(const uint8_t key[32], uint64_t nonce) {
+        __m128i k0 = _mm_loadu_si128((const __m128i*)key);
+        __m128i k1 = _mm_loadu_si128((const __m128i*)(key + 16));
+
+        rk[0] = k0;
+        rk[1] = k1;
+        rk[2] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x01)); k0 = rk[2];
+        rk[3] = key_expand2(k1, k0); k1 = rk[3];
+        rk[4] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x02)); k0 = rk[4];
+        rk[5] = key_expand2(k1, k0); k1 = rk[5];
+        rk[6] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x04)); k0 = rk[6];
+        rk[7] = key_expand2(k1, k0); k1 = rk[7];
+        rk[8] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x08)); k0 = rk[8];
+        rk[9] = key_expand2(k1, k0); k1 = rk[9];
+        rk[10] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x10)); k0 = rk[10];
+        rk[11] = key_expand2(k1, k0); k1 = rk[11];
+        rk[12] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x20)); k0 = rk[12];
+        rk[13] = key_expand2(k1, k0); k1 = rk[13];
+        rk[14] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x40));
+
+        ctr = _mm_set_epi64x(0, (long long)nonce);
+        has_buf = false;
+    }
+
+    inline __m128i encrypt_ctr() {
+        __m128i t = _mm_xor_si128(ctr, rk[0]);
+        t = _mm_aesenc_si128(t, rk[1]);
+        t = _mm_aesenc_si128(t, rk[2]);
+        t = _mm_aesenc_si128(t, rk[3]);
+        t = _mm_aesenc_si128(t, rk[4]);
+        t = _mm_aesenc_si128(t, rk[5]);
+        t = _mm_aesenc_si128(t, rk[6]);
+        t = _mm_aesenc_si128(t, rk[7]);
+        t = _mm_aesenc_si128(t, rk[8]);
+        t = _mm_aesenc_si128(t, rk[9]);
+        t = _mm_aesenc_si128(t, rk[10]);
+        t = _mm_aesenc_si128(t, rk[11]);
+        t = _mm_aesenc_si128(t, rk[12]);
+        t = _mm_aesenc_si128(t, rk[13]);
+        t = _mm_aesenclast_si128(t, rk[14]);
+        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, 1));
+        return t;
+    }
+
+    inline uint64_t next_u64() {
+        if (has_buf) {
+            has_buf = false;
+            return buf[1];
+        }
+        __m128i ct = encrypt_ctr();
+        _mm_store_si128((__m128i*)buf, ct);
+        has_buf = true;
+        return buf[0];
+    }
+
+    inline void fill_u64(uint64_t* out, size_t n) {
+        size_t i = 0;
+        if (has_buf && n > 0) {
+            out[0] = buf[1];
+            has_buf = false;
+            i = 1;
+        }
+        alignas(16) uint64_t tmp[2];
+        for (; i + 1 < n; i += 2) {
+            __m128i ct = encrypt_ctr();
+            _mm_store_si128((__m128i*)tmp, ct);
+            out[i] = tmp[0];
+            out[i + 1] = tmp[1];
+        }
+        if (i < n) {
+            __m128i ct = encrypt_ctr();
+            _mm_store_si128((__m128i*)buf, ct);
+            out[i] = buf[0];
+            has_buf = true;
+        }
+    }
+
+    inline uint64_t bounded(uint64_t M) {
+        if (M <= 1) return 0;
+        uint64_t lim = UINT64_MAX - (UINT64_MAX % M);
+        for (;;) {
+            uint64_t x = next_u64();
+            if (x < lim) return x % M;
+        }
+    }
+};
+
+#else
+
+#error "hfhe requires aes-ni support (compile with -march=native or -maes on x86_64)"
+
+#endif
+
+}
@@ -3,6 +3,11 @@
 #include <cstdint>
 #include <cstdlib>
 #include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__BMI2__) && defined(__ADX__)
+#include <immintrin.h>
+#endif
 
 #if !defined(__SIZEOF_INT128__) && !(defined(_MSC_VER) && defined(__clang__))
 #error "Needs unsigned __int128"
@@ -72,6 +77,8 @@ inline Fp fp_sub(const Fp& a, const Fp& b) {
 
 #if defined(_MSC_VER) && !defined(__clang__)
 
+inline constexpr const char* FP_MUL_IMPL = "umul128";
+
 inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
                        uint64_t& z0, uint64_t& z1, uint64_t& z2, uint64_t& z3) {
     uint64_t h00, h01, h10, h11;
@@ -108,53 +115,64 @@ inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
     z3 = h11 + c2;
 }
 
-#elif defined(__x86_64__) && defined(__GNUC__) && !defined(_MSC_VER)
+inline void sqr128(uint64_t a0, uint64_t a1,
+                   uint64_t& z0, uint64_t& z1, uint64_t& z2, uint64_t& z3) {
+    mul128x128(a0, a1, a0, a1, z0, z1, z2, z3);
+}
+
+#elif defined(__x86_64__) && defined(__BMI2__) && defined(__ADX__)
+
+inline constexpr const char* FP_MUL_IMPL = "mulx";
 
 inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
                        uint64_t& z0, uint64_t& z1, uint64_t& z2, uint64_t& z3) {
-    uint64_t p00_lo, p00_hi;
-    uint64_t p01_lo, p01_hi;
-    uint64_t p10_lo, p10_hi;
-    uint64_t p11_lo, p11_hi;
-
-    __asm__ volatile(
-        "movq %[a0], %%rax\n\t"
-        "mulq %[b0]\n\t"
-        "movq %%rax, %[p00_lo]\n\t"
-        "movq %%rdx, %[p00_hi]\n\t"
-        "movq %[a0], %%rax\n\t"
-        "mulq %[b1]\n\t"
-        "movq %%rax, %[p01_lo]\n\t"
-        "movq %%rdx, %[p01_hi]\n\t"
-        "movq %[a1], %%rax\n\t"
-        "mulq %[b0]\n\t"
-        "movq %%rax, %[p10_lo]\n\t"
-        "movq %%rdx, %[p10_hi]\n\t"
-        "movq %[a1], %%rax\n\t"
-        "mulq %[b1]\n\t"
-        "movq %%rax, %[p11_lo]\n\t"
-        "movq %%rdx, %[p11_hi]\n\t"
-        : [p00_lo]"=&r"(p00_lo), [p00_hi]"=&r"(p00_hi),
-          [p01_lo]"=&r"(p01_lo), [p01_hi]"=&r"(p01_hi),
-          [p10_lo]"=&r"(p10_lo), [p10_hi]"=&r"(p10_hi),
-          [p11_lo]"=&r"(p11_lo), [p11_hi]"=&r"(p11_hi)
-        : [a0]"r"(a0), [a1]"r"(a1), [b0]"r"(b0), [b1]"r"(b1)
-        : "rax", "rdx", "cc"
-    );
-
-    z0 = p00_lo;
-
-    u128 m1 = (u128)p00_hi + (u128)p01_lo + (u128)p10_lo;
-    z1 = (uint64_t)m1;
-
-    u128 m2 = (u128)p01_hi + (u128)p10_hi + (u128)p11_lo + (m1 >> 64);
-    z2 = (uint64_t)m2;
-
-    z3 = p11_hi + (uint64_t)(m2 >> 64);
+    unsigned long long h00, h01, h10, h11, r1, r2, r3;
+
+    z0 = _mulx_u64(a0, b0, &h00);
+    unsigned long long l01 = _mulx_u64(a0, b1, &h01);
+    unsigned long long l10 = _mulx_u64(a1, b0, &h10);
+    unsigned long long l11 = _mulx_u64(a1, b1, &h11);
+
+    // two carry chains, (h00, l11, h11) + (l01, h01) then + (l10, h10)
+    unsigned char c = _addcarryx_u64(0, h00, l01, &r1);
+    c = _addcarryx_u64(c, l11, h01, &r2);
+    _addcarryx_u64(c, h11, 0, &r3);
+
+    c = _addcarryx_u64(0, r1, l10, &r1);
+    c = _addcarryx_u64(c, r2, h10, &r2);
+    _addcarryx_u64(c, r3, 0, &r3);
+
+    z1 = r1;
+    z2 = r2;
+    z3 = r3;
+}
+
+// a0^2 + 2 a0 a1 2^64 + a1^2 2^128, one mul fewer than mul128x128
+inline void sqr128(uint64_t a0, uint64_t a1,
+                   uint64_t& z0, uint64_t& z1, uint64_t& z2, uint64_t& z3) {
+    unsigned long long h00, h01, h11, r1, r2, r3;
+
+    z0 = _mulx_u64(a0, a0, &h00);
+    unsigned long long l01 = _mulx_u64(a0, a1, &h01);
+    unsigned long long l11 = _mulx_u64(a1, a1, &h11);
+
+    unsigned long long d2 = (h01 << 1) | (l01 >> 63);
+    unsigned long long d1 = l01 << 1;
+    unsigned long long d3 = h01 >> 63;
+
+    unsigned char c = _addcarryx_u64(0, h00, d1, &r1);
+    c = _addcarryx_u64(c, l11, d2, &r2);
+    _addcarryx_u64(c, h11, d3, &r3);
+
+    z1 = r1;
+    z2 = r2;
+    z3 = r3;
 }
 
 #else
 
+inline constexpr const char* FP_MUL_IMPL = "u128";
+
 inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
                        uint64_t& z0, uint64_t& z1, uint64_t& z2, uint64_t& z3) {
     u128 c0 = (u128)a0 * (u128)b0;
@@ -174,6 +192,23 @@ inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
     z3 = (uint64_t)t3;
 }
 
+inline void sqr128(uint64_t a0, uint64_t a1,
+                   uint64_t& z0, uint64_t& z1, uint64_t& z2, uint64_t& z3) {
+    u128 c0 = (u128)a0 * (u128)a0;
+    u128 c1 = (u128)a0 * (u128)a1;
+    u128 c3 = (u128)a1 * (u128)a1;
+
+    z0 = (uint64_t)c0;
+
+    u128 t = (c0 >> 64) + ((u128)(uint64_t)c1 << 1);
+    z1 = (uint64_t)t;
+
+    u128 t2 = ((c1 >> 64) << 1) + (u128)(uint64_t)c3 + (t >> 64);
+    z2 = (uint64_t)t2;
+
+    z3 = (uint64_t)((c3 >> 64) + (t2 >> 64));
+}
+
 #endif
 
 inline Fp fp_reduce256(uint64_t z0, uint64_t z1, uint64_t z2, uint64_t z3) {
@@ -212,6 +247,69 @@ inline Fp fp_mul(const Fp& a, const Fp& b) {
     return fp_reduce256(z0, z1, z2, z3);
 }
 
+inline Fp fp_sqr(const Fp& a) {
+    uint64_t z0, z1, z2, z3;
+    sqr128(a.lo, a.hi, z0, z1, z2, z3);
+    return fp_reduce256(z0, z1, z2, z3);
+}
+
+// unreduced sum of products: two 320-bit lanes, one per sign. a product is
+// below 2^254, so 2^66 terms fit before a lane wraps and only the read reduces
+struct FpAcc {
+    uint64_t pos[5] = {0, 0, 0, 0, 0};
+    uint64_t neg[5] = {0, 0, 0, 0, 0};
+};
+
+inline void fp_lane_add(uint64_t* w, uint64_t z0, uint64_t z1, uint64_t z2, uint64_t z3) {
+    u128 t = (u128)w[0] + z0;
+    w[0] = (uint64_t)t;
+    t = (u128)w[1] + z1 + (uint64_t)(t >> 64);
+    w[1] = (uint64_t)t;
+    t = (u128)w[2] + z2 + (uint64_t)(t >> 64);
+    w[2] = (uint64_t)t;
+    t = (u128)w[3] + z3 + (uint64_t)(t >> 64);
+    w[3] = (uint64_t)t;
+    w[4] += (uint64_t)(t >> 64);
+}
+
+// 2^256 = 2^2 mod p
+inline Fp fp_lane_get(const uint64_t* w) {
+    return fp_add(fp_reduce256(w[0], w[1], w[2], w[3]), fp_from_words(w[4] << 2, w[4] >> 62));
+}
+
+inline void fp_acc_add(FpAcc& acc, const Fp& x) {
+    fp_lane_add(acc.pos, x.lo, x.hi, 0, 0);
+}
+
+inline void fp_acc_sub(FpAcc& acc, const Fp& x) {
+    fp_lane_add(acc.neg, x.lo, x.hi, 0, 0);
+}
+
+inline void fp_acc_muladd(FpAcc& acc, const Fp& a, const Fp& b) {
+    uint64_t z0, z1, z2, z3;
+    mul128x128(a.lo, a.hi, b.lo, b.hi, z0, z1, z2, z3);
+    fp_lane_add(acc.pos, z0, z1, z2, z3);
+}
+
+inline void fp_acc_mulsub(FpAcc& acc, const Fp& a, const Fp& b) {
+    uint64_t z0, z1, z2, z3;
+    mul128x128(a.lo, a.hi, b.lo, b.hi, z0, z1, z2, z3);
+    fp_lane_add(acc.neg, z0, z1, z2, z3);
+}
+
+// the lanes on their own, for callers that keep the signs apart
+inline Fp fp_acc_pos(const FpAcc& acc) {
+    return fp_lane_get(acc.pos);
+}
+
+inline Fp fp_acc_neg(const FpAcc& acc) {
+    return fp_lane_get(acc.neg);
+}
+
+inline Fp fp_acc_get(const FpAcc& acc) {
+    return fp_sub(fp_acc_pos(acc), fp_acc_neg(acc));
+}
+
 inline Fp fp_pow_u64(Fp a, uint64_t e) {
     Fp r = fp_from_u64(1);
 
@@ -219,7 +317,7 @@ inline Fp fp_pow_u64(Fp a, uint64_t e) {
         if (e & 1) {
             r = fp_mul(r, a);
         }
-        a = fp_mul(a, a);
+        a = fp_sqr(a);
         e >>= 1;
     }
 
@@ -244,7 +342,7 @@ inline Fp fp_inv_ct(const Fp& a) {
 
     while (pos >= 0) {
         if (((e >> pos) & 1) == 0) {
-            r = fp_mul(r, r);
+            r = fp_sqr(r);
             pos--;
             continue;
         }
@@ -258,7 +356,7 @@ inline Fp fp_inv_ct(const Fp& a) {
         }
 
         for (int i = 0; i < pos - l + 1; i++) {
-            r = fp_mul(r, r);
+            r = fp_sqr(r);
         }
 
         r = fp_mul(r, tbl[k]);
@@ -268,8 +366,218 @@ inline Fp fp_inv_ct(const Fp& a) {
     return r;
 }
 
+// Bernstein-Yang safegcd in the half-delta form: 7 batches of 59 branch-free
+// divsteps on signed 62-bit limbs, each batch applied as one 2x2 matrix.
+// 413 steps is past the 127-bit bound, the count never depends on the input
+namespace fpi {
+
+using i128 = __int128;
+
+constexpr uint64_t M62 = UINT64_MAX >> 2;
+
+// p = 2^127 - 1 in limbs of 62, 62 and 3 bits; p = -1 mod 2^62 so p^-1 = -1 too
+constexpr int64_t P0 = (int64_t)M62, P1 = (int64_t)M62, P2 = 7;
+constexpr uint64_t PINV62 = M62;
+
+struct S62 { int64_t v[3]; };
+struct T2 { int64_t u, v, q, r; };
+
+// 59 divsteps on the low bits of f, g; the matrix comes back scaled by 2^62
+inline int64_t divsteps_59(int64_t zeta, uint64_t f0, uint64_t g0, T2& t) {
+    uint64_t u = 8, v = 0, q = 0, r = 8;
+    uint64_t f = f0, g = g0;
+
+    for (int i = 3; i < 62; i++) {
+        uint64_t m1 = (uint64_t)(zeta >> 63);
+        uint64_t m2 = 0 - (g & 1);
+
+        uint64_t x = (f ^ m1) - m1;
+        uint64_t y = (u ^ m1) - m1;
+        uint64_t z = (v ^ m1) - m1;
+
+        g += x & m2;
+        q += y & m2;
+        r += z & m2;
+
+        m1 &= m2;
+        zeta = (zeta ^ (int64_t)m1) - 1;
+
+        f += g & m1;
+        u += q & m1;
+        v += r & m1;
+
+        g >>= 1;
+        u <<= 1;
+        v <<= 1;
+    }
+
+    t = T2 { (int64_t)u, (int64_t)v, (int64_t)q, (int64_t)r };
+    return zeta;
+}
+
+// [d, e] = t [d, e] / 2^62 mod p, with a multiple of p added so the division is exact
+inline void update_de(S62& d, S62& e, const T2& t) {
+    int64_t sd = d.v[2] >> 63, se = e.v[2] >> 63;
+    int64_t md = (t.u & sd) + (t.v & se);
+    int64_t me = (t.q & sd) + (t.r & se);
+
+    i128 cd = (i128)t.u * d.v[0] + (i128)t.v * e.v[0];
+    i128 ce = (i128)t.q * d.v[0] + (i128)t.r * e.v[0];
+
+    md -= (int64_t)((PINV62 * (uint64_t)cd + (uint64_t)md) & M62);
+    me -= (int64_t)((PINV62 * (uint64_t)ce + (uint64_t)me) & M62);
+
+    cd += (i128)P0 * md;
+    ce += (i128)P0 * me;
+    cd >>= 62;
+    ce >>= 62;
+
+    cd += (i128)t.u * d.v[1] + (i128)t.v * e.v[1] + (i128)P1 * md;
+    ce += (i128)t.q * d.v[1] + (i128)t.r * e.v[1] + (i128)P1 * me;
+    int64_t d0 = (int64_t)((uint64_t)cd & M62), e0 = (int64_t)((uint64_t)ce & M62);
+    cd >>= 62;
+    ce >>= 62;
+
+    cd += (i128)t.u * d.v[2] + (i128)t.v * e.v[2] + (i128)P2 * md;
+    ce += (i128)t.q * d.v[2] + (i128)t.r * e.v[2] + (i128)P2 * me;
+    int64_t d1 = (int64_t)((uint64_t)cd & M62), e1 = (int64_t)((uint64_t)ce & M62);
+    cd >>= 62;
+    ce >>= 62;
+
+    d = S62 { { d0, d1, (int64_t)cd } };
+    e = S62 { { e0, e1, (int64_t)ce } };
+}
+
+// [f, g] = t [f, g] / 2^62, exact by construction
+inline void update_fg(S62& f, S62& g, const T2& t) {
+    i128 cf = (i128)t.u * f.v[0] + (i128)t.v * g.v[0];
+    i128 cg = (i128)t.q * f.v[0] + (i128)t.r * g.v[0];
+    cf >>= 62;
+    cg >>= 62;
+
+    cf += (i128)t.u * f.v[1] + (i128)t.v * g.v[1];
+    cg += (i128)t.q * f.v[1] + (i128)t.r * g.v[1];
+    int64_t f0 = (int64_t)((uint64_t)cf & M62), g0 = (int64_t)((uint64_t)cg & M62);
+    cf >>= 62;
+    cg >>= 62;
+
+    cf += (i128)t.u * f.v[2] + (i128)t.v * g.v[2];
+    cg += (i128)t.q * f.v[2] + (i128)t.r * g.v[2];
+    int64_t f1 = (int64_t)((uint64_t)cf & M62), g1 = (int64_t)((uint64_t)cg & M62);
+    cf >>= 62;
+    cg >>= 62;
+
+    f = S62 { { f0, f1, (int64_t)cf } };
+    g = S62 { { g0, g1, (int64_t)cg } };
+}
+
+// d in (-2p, p) times sign(f) -> [0, p)
+inline void normalize(S62& d, int64_t fsign) {
+    int64_t r0 = d.v[0], r1 = d.v[1], r2 = d.v[2];
+
+    int64_t add = r2 >> 63;
+    r0 += P0 & add;
+    r1 += P1 & add;
+    r2 += P2 & add;
+
+    int64_t neg = fsign >> 63;
+    r0 = (r0 ^ neg) - neg;
+    r1 = (r1 ^ neg) - neg;
+    r2 = (r2 ^ neg) - neg;
+
+    r1 += r0 >> 62; r0 &= (int64_t)M62;
+    r2 += r1 >> 62; r1 &= (int64_t)M62;
+
+    add = r2 >> 63;
+    r0 += P0 & add;
+    r1 += P1 & add;
+    r2 += P2 & add;
+
+    r1 += r0 >> 62; r0 &= (int64_t)M62;
+    r2 += r1 >> 62; r1 &= (int64_t)M62;
+
+    d = S62 { { r0, r1, r2 } };
+}
+
+}
+
+inline Fp fp_inv_divsteps(const Fp& a) {
+    using namespace fpi;
+
+    S62 d { { 0, 0, 0 } };
+    S62 e { { 1, 0, 0 } };
+    S62 f { { P0, P1, P2 } };
+    S62 g { { (int64_t)(a.lo & M62), (int64_t)(((a.lo >> 62) | (a.hi << 2)) & M62), (int64_t)(a.hi >> 60) } };
+
+    int64_t zeta = -1;
+    for (int i = 0; i < 7; i++) {
+        T2 t;
+        zeta = divsteps_59(zeta, (uint64_t)f.v[0], (uint64_t)g.v[0], t);
+        update_de(d, e, t);
+        update_fg(f, g, t);
+    }
+
+    // g = 0 and f = +-1 now (f = +-p for a = 0, d stays 0)
+    normalize(d, f.v[2]);
+
+    uint64_t lo = (uint64_t)d.v[0] | ((uint64_t)d.v[1] << 62);
+    uint64_t hi = ((uint64_t)d.v[1] >> 2) | ((uint64_t)d.v[2] << 60);
+    return Fp { lo, hi };
+}
+
+enum class FpInvImpl { POW, DIVSTEPS };
+
+// both are constant time, POW is the fixed-window chain above
+inline FpInvImpl g_fp_inv = FpInvImpl::DIVSTEPS;
+
 inline Fp fp_inv(const Fp& a) {
-    return fp_inv_ct(a);
+    return g_fp_inv == FpInvImpl::DIVSTEPS ? fp_inv_divsteps(a) : fp_inv_ct(a);
+}
+
+// out[i] = in[i]^-1 (0 for 0) with one inversion and 3(n-1) muls,
+// in and out may alias. skips zeros with a branch, so public inputs only
+inline void fp_inv_batch(const Fp* in, Fp* out, size_t n) {
+    if (n == 0) return;
+
+    std::vector<Fp> pre(n);
+    Fp acc = fp_from_u64(1);
+    for (size_t i = 0; i < n; i++) {
+        pre[i] = acc;
+        if (in[i].lo | in[i].hi) acc = fp_mul(acc, in[i]);
+    }
+
+    Fp inv = fp_inv(acc);
+    for (size_t i = n; i-- > 0; ) {
+        Fp x = in[i];
+        if (!(x.lo | x.hi)) { out[i] = x; continue; }
+        out[i] = fp_mul(inv, pre[i]);
+        inv = fp_mul(inv, x);
+    }
+}
+
+// same result as fp_inv on every element: zeros are swapped for 1 through
+// masks and cleared at the end, the mul sequence never depends on the values
+inline void fp_inv_batch_ct(const Fp* in, Fp* out, size_t n) {
+    if (n == 0) return;
+
+    std::vector<Fp> pre(n);
+    std::vector<uint64_t> zm(n);
+    Fp acc = fp_from_u64(1);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t nz = in[i].lo | in[i].hi;
+        zm[i] = ((nz | (0 - nz)) >> 63) - 1;
+        Fp x { (in[i].lo & ~zm[i]) | (zm[i] & 1), in[i].hi & ~zm[i] };
+        pre[i] = acc;
+        acc = fp_mul(acc, x);
+    }
+
+    Fp inv = fp_inv(acc);
+    for (size_t i = n; i-- > 0; ) {
+        Fp x { (in[i].lo & ~zm[i]) | (zm[i] & 1), in[i].hi & ~zm[i] };
+        Fp r = fp_mul(inv, pre[i]);
+        inv = fp_mul(inv, x);
+        out[i] = Fp { r.lo & ~zm[i], r.hi & ~zm[i] };
+    }
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "field.hpp"
+
+#if defined(__AVX512F__) && defined(__AVX512IFMA__)
+#include <immintrin.h>
+#define PVAC_FP_IFMA 1
+#endif
+
+namespace pvac {
+
+// batch kernels over contiguous Fp arrays, outputs are canonical and may alias inputs
+//   fp_add_vec(a, b, out, n)      out[i] = a[i] + b[i]
+//   fp_mul_vec(a, b, out, n)      out[i] = a[i] * b[i]
+//   fp_mul_vec(a, s, out, n)      out[i] = a[i] * s
+//   fp_muladd_vec(a, b, n, acc)   acc + sum a[i] * b[i]
+//
+// with AVX-512 IFMA 8 lanes go through madd52 in radix 2^52: three limbs
+// (52, 52, 23 bits), 2^156 = 2^29 and 2^208 = 2^81 mod p fold the high columns back.
+// AVX2 only has a 32x32 multiplier, 16 of those plus carry fixups per lane lose to
+// one scalar mulx product, so everything else takes the scalar loop
+
+// AoS callers (edge weights) gather this many at a time into stack buffers
+inline constexpr size_t FP_VEC_CHUNK = 256;
+
+#if defined(PVAC_FP_IFMA)
+
+inline constexpr const char* FP_VEC_IMPL = "ifma";
+
+namespace fpv {
+
+struct V3 { __m512i l0, l1, l2; };
+
+inline __m512i m52() { return _mm512_set1_epi64((1ull << 52) - 1); }
+inline __m512i m23() { return _mm512_set1_epi64((1ull << 23) - 1); }
+
+// zero-masked shifts, the plain intrinsics trip gcc 12 -Wmaybe-uninitialized
+template<unsigned k> inline __m512i sl(__m512i x) { return _mm512_maskz_slli_epi64(0xFF, x, k); }
+template<unsigned k> inline __m512i sr(__m512i x) { return _mm512_maskz_srli_epi64(0xFF, x, k); }
+
+// 8 Fp (lo,hi interleaved) -> limbs
+inline V3 load8(const Fp* p) {
+    const __m512i ie = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m512i io = _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+    __m512i v0 = _mm512_loadu_si512((const void*)p);
+    __m512i v1 = _mm512_loadu_si512((const void*)(p + 4));
+    __m512i lo = _mm512_permutex2var_epi64(v0, ie, v1);
+    __m512i hi = _mm512_permutex2var_epi64(v0, io, v1);
+
+    V3 r;
+    r.l0 = _mm512_and_si512(lo, m52());
+    r.l1 = _mm512_and_si512(_mm512_or_si512(sr<52>(lo), sl<12>(hi)), m52());
+    r.l2 = sr<40>(hi);
+    return r;
+}
+
+inline V3 bcast(const Fp& s) {
+    V3 r;
+    r.l0 = _mm512_set1_epi64((long long)(s.lo & ((1ull << 52) - 1)));
+    r.l1 = _mm512_set1_epi64((long long)(((s.lo >> 52) | (s.hi << 12)) & ((1ull << 52) - 1)));
+    r.l2 = _mm512_set1_epi64((long long)(s.hi >> 40));
+    return r;
+}
+
+// l0, l1 < 2^52 and value < 2^128 in, same bounds out with l2 <= 2^23
+inline void carry(V3& v) {
+    v.l1 = _mm512_add_epi64(v.l1, sr<52>(v.l0));
+    v.l0 = _mm512_and_si512(v.l0, m52());
+    v.l2 = _mm512_add_epi64(v.l2, sr<52>(v.l1));
+    v.l1 = _mm512_and_si512(v.l1, m52());
+}
+
+// bits >= 127 wrap to bit 0
+inline void wrap(V3& v) {
+    v.l0 = _mm512_add_epi64(v.l0, sr<23>(v.l2));
+    v.l2 = _mm512_and_si512(v.l2, m23());
+    carry(v);
+}
+
+inline void store8(Fp* p, V3 v) {
+    wrap(v);
+    wrap(v);
+
+    __mmask8 eq = _mm512_cmpeq_epi64_mask(v.l0, m52())
+                & _mm512_cmpeq_epi64_mask(v.l1, m52())
+                & _mm512_cmpeq_epi64_mask(v.l2, m23());
+    v.l0 = _mm512_maskz_mov_epi64((__mmask8)~eq, v.l0);
+    v.l1 = _mm512_maskz_mov_epi64((__mmask8)~eq, v.l1);
+    v.l2 = _mm512_maskz_mov_epi64((__mmask8)~eq, v.l2);
+
+    __m512i lo = _mm512_or_si512(v.l0, sl<52>(v.l1));
+    __m512i hi = _mm512_or_si512(sr<12>(v.l1), sl<40>(v.l2));
+
+    const __m512i i0 = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+    const __m512i i1 = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+    _mm512_storeu_si512((void*)p, _mm512_permutex2var_epi64(lo, i0, hi));
+    _mm512_storeu_si512((void*)(p + 4), _mm512_permutex2var_epi64(lo, i1, hi));
+}
+
+inline V3 add(V3 a, const V3& b) {
+    a.l0 = _mm512_add_epi64(a.l0, b.l0);
+    a.l1 = _mm512_add_epi64(a.l1, b.l1);
+    a.l2 = _mm512_add_epi64(a.l2, b.l2);
+    carry(a);
+    wrap(a);
+    return a;
+}
+
+// a2, b2 < 2^24 so a2*b2 has no high half, every column stays under 2^56
+inline V3 mul(const V3& a, const V3& b) {
+    const __m512i z = _mm512_setzero_si512();
+
+    __m512i c0 = _mm512_madd52lo_epu64(z, a.l0, b.l0);
+
+    __m512i c1 = _mm512_madd52hi_epu64(z, a.l0, b.l0);
+    c1 = _mm512_madd52lo_epu64(c1, a.l0, b.l1);
+    c1 = _mm512_madd52lo_epu64(c1, a.l1, b.l0);
+
+    __m512i c2 = _mm512_madd52hi_epu64(z, a.l0, b.l1);
+    c2 = _mm512_madd52hi_epu64(c2, a.l1, b.l0);
+    c2 = _mm512_madd52lo_epu64(c2, a.l0, b.l2);
+    c2 = _mm512_madd52lo_epu64(c2, a.l1, b.l1);
+    c2 = _mm512_madd52lo_epu64(c2, a.l2, b.l0);
+
+    __m512i c3 = _mm512_madd52hi_epu64(z, a.l0, b.l2);
+    c3 = _mm512_madd52hi_epu64(c3, a.l1, b.l1);
+    c3 = _mm512_madd52hi_epu64(c3, a.l2, b.l0);
+    c3 = _mm512_madd52lo_epu64(c3, a.l1, b.l2);
+    c3 = _mm512_madd52lo_epu64(c3, a.l2, b.l1);
+
+    __m512i c4 = _mm512_madd52hi_epu64(z, a.l1, b.l2);
+    c4 = _mm512_madd52hi_epu64(c4, a.l2, b.l1);
+    c4 = _mm512_madd52lo_epu64(c4, a.l2, b.l2);
+
+    // c3 * 2^156 = c3 * 2^29, c4 * 2^208 = c4 * 2^81
+    V3 r;
+    r.l0 = _mm512_add_epi64(c0, sl<29>(_mm512_and_si512(c3, m23())));
+    r.l1 = _mm512_add_epi64(_mm512_add_epi64(c1, sr<23>(c3)),
+                            sl<29>(_mm512_and_si512(c4, m23())));
+    r.l2 = _mm512_add_epi64(c2, sr<23>(c4));
+    carry(r);
+    wrap(r);
+    return r;
+}
+
+inline Fp hsum(const V3& v) {
+    alignas(64) Fp t[8];
+    store8(t, v);
+    Fp s = t[0];
+    for (int i = 1; i < 8; i++) s = fp_add(s, t[i]);
+    return s;
+}
+
+}
+
+inline void fp_add_vec(const Fp* a, const Fp* b, Fp* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) fpv::store8(out + i, fpv::add(fpv::load8(a + i), fpv::load8(b + i)));
+    for (; i < n; i++) out[i] = fp_add(a[i], b[i]);
+}
+
+inline void fp_mul_vec(const Fp* a, const Fp* b, Fp* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) fpv::store8(out + i, fpv::mul(fpv::load8(a + i), fpv::load8(b + i)));
+    for (; i < n; i++) out[i] = fp_mul(a[i], b[i]);
+}
+
+inline void fp_mul_vec(const Fp* a, const Fp& s, Fp* out, size_t n) {
+    fpv::V3 sv = fpv::bcast(s);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) fpv::store8(out + i, fpv::mul(fpv::load8(a + i), sv));
+    for (; i < n; i++) out[i] = fp_mul(a[i], s);
+}
+
+inline Fp fp_muladd_vec(const Fp* a, const Fp* b, size_t n, Fp acc) {
+    size_t i = 0;
+    if (n >= 8) {
+        fpv::V3 s = fpv::mul(fpv::load8(a), fpv::load8(b));
+        for (i = 8; i + 8 <= n; i += 8) s = fpv::add(s, fpv::mul(fpv::load8(a + i), fpv::load8(b + i)));
+        acc = fp_add(acc, fpv::hsum(s));
+    }
+    FpAcc t;
+    for (; i < n; i++) fp_acc_muladd(t, a[i], b[i]);
+    return fp_add(acc, fp_acc_pos(t));
+}
+
+#else
+
+inline constexpr const char* FP_VEC_IMPL = "scalar";
+
+inline void fp_add_vec(const Fp* a, const Fp* b, Fp* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = fp_add(a[i], b[i]);
+}
+
+inline void fp_mul_vec(const Fp* a, const Fp* b, Fp* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = fp_mul(a[i], b[i]);
+}
+
+inline void fp_mul_vec(const Fp* a, const Fp& s, Fp* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = fp_mul(a[i], s);
+}
+
+inline Fp fp_muladd_vec(const Fp* a, const Fp* b, size_t n, Fp acc) {
+    FpAcc t;
+    for (size_t i = 0; i < n; i++) fp_acc_muladd(t, a[i], b[i]);
+    return fp_add(acc, fp_acc_pos(t));
+}
+
+#endif
+
+}
@@ -154,13 +154,8 @@ struct Sha256 {
     void finish(uint8_t out[32]) {
         uint64_t bitlen = len * 8;
 
-        uint8_t b0 = 0x80;
-        update(&b0, 1);
-
-        uint8_t z = 0;
-        while (ptr != 56) {
-            update(&z, 1);
-        }
+        uint8_t pad[64] = { 0x80 };
+        update(pad, (ptr < 56) ? (56 - ptr) : (120 - ptr));
 
         uint8_t be[8];
         for (int i = 0; i < 8; i++) {
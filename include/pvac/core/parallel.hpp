@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "random.hpp"
+
+namespace pvac {
+
+// PVAC_THREADS=<n> caps every parallel loop, default is one per hardware thread
+inline int g_threads = []() {
+    const char * s = std::getenv("PVAC_THREADS");
+    if (s && std::atoi(s) > 0) return std::atoi(s);
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? (int)n : 1;
+}();
+
+inline void set_num_threads(int n) {
+    g_threads = std::max(1, n);
+}
+
+inline int get_num_threads() {
+    return g_threads;
+}
+
+// how far a call may spread, threads = 0 follows g_threads, 1 runs inline
+struct ExecPolicy {
+    int threads = 0;
+};
+
+inline constexpr ExecPolicy exec_seq { 1 };
+inline constexpr ExecPolicy exec_par { 0 };
+
+// policy of the calling thread, every library loop below it follows
+inline thread_local ExecPolicy g_exec {};
+
+// ExecScope s(exec_seq); keeps one call path off the pool
+struct ExecScope {
+    ExecPolicy prev;
+    explicit ExecScope(ExecPolicy p) : prev(g_exec) { g_exec = p; }
+    ~ExecScope() { g_exec = prev; }
+    ExecScope(const ExecScope &) = delete;
+    ExecScope & operator=(const ExecScope &) = delete;
+};
+
+// set inside workers, nested loops then run inline instead of posting again
+inline thread_local bool g_in_parallel = false;
+
+// number of workers parallel_for(n, ...) will use
+inline size_t parallel_width(size_t n, ExecPolicy pol = g_exec) {
+    if (g_in_parallel) return 1;
+    int t = pol.threads > 0 ? std::min(pol.threads, g_threads) : g_threads;
+    return std::max<size_t>(1, std::min((size_t)t, n));
+}
+
+namespace par {
+
+// [lo, hi) packed in one word so owner pops and thief splits are single CAS
+struct alignas(64) Slot {
+    std::atomic<uint64_t> r { 0 };
+};
+
+inline uint64_t pack(uint64_t lo, uint64_t hi) { return lo | (hi << 32); }
+inline uint64_t lo_of(uint64_t r) { return r & 0xFFFFFFFFull; }
+inline uint64_t hi_of(uint64_t r) { return r >> 32; }
+
+struct Job {
+    size_t T = 0;
+    void (*call)(void *, size_t, size_t) = nullptr;
+    void * ctx = nullptr;
+    std::vector<Slot> slot;
+
+    // first exception thrown by f on any worker, the caller rethrows it
+    std::atomic<bool> failed { false };
+    std::exception_ptr err;
+
+    Job(size_t n, size_t T_) : T(T_), slot(T_) {
+        for (size_t w = 0; w < T; ++w)
+            slot[w].r.store(pack(n * w / T, n * (w + 1) / T), std::memory_order_relaxed);
+    }
+
+    // front of the own range
+    bool pop(size_t w, size_t & i) {
+        uint64_t r = slot[w].r.load(std::memory_order_acquire);
+        while (lo_of(r) < hi_of(r)) {
+            if (slot[w].r.compare_exchange_weak(r, pack(lo_of(r) + 1, hi_of(r)), std::memory_order_acq_rel)) {
+                i = lo_of(r);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // upper half of the fullest other range, the first index is ours to run
+    bool steal(size_t w, size_t & i) {
+        for (;;) {
+            size_t best = T;
+            uint64_t br = 0, most = 0;
+            for (size_t k = 1; k < T; ++k) {
+                size_t v = (w + k) % T;
+                uint64_t r = slot[v].r.load(std::memory_order_acquire);
+                if (hi_of(r) > lo_of(r) && hi_of(r) - lo_of(r) > most) { best = v; br = r; most = hi_of(r) - lo_of(r); }
+            }
+            if (best == T) return false;
+
+            uint64_t lo = lo_of(br), hi = hi_of(br), mid = lo + (hi - lo) / 2;
+            if (!slot[best].r.compare_exchange_strong(br, pack(lo, mid), std::memory_order_acq_rel)) continue;
+
+            slot[w].r.store(pack(mid + 1, hi), std::memory_order_release);
+            i = mid;
+            return true;
+        }
+    }
+
+    // never throws, after a failure the remaining indices are dropped
+    void run(size_t w) {
+        try {
+            for (size_t i; !failed.load(std::memory_order_relaxed) && (pop(w, i) || steal(w, i)); ) call(ctx, i, w);
+        } catch (...) {
+            if (!failed.exchange(true)) err = std::current_exception();
+        }
+    }
+};
+
+struct InParallel {
+    bool was = g_in_parallel;
+    InParallel() { g_in_parallel = true; }
+    ~InParallel() { g_in_parallel = was; }
+};
+
+// workers start on first use and stay parked on a condition variable. one job
+// at a time, a second caller (a user thread, EncPool refill) runs its loop
+// inline instead of queueing. never destroyed, the workers are detached and a
+// forked child gets a fresh pool
+struct Pool {
+    std::mutex mu;
+    std::condition_variable cv, done;
+    std::mutex busy;
+
+    std::vector<std::thread::id> ids;
+    uint64_t epoch = 0;
+    Job * job = nullptr;
+    size_t T = 0;
+    size_t left = 0;
+
+    void grow(size_t want) {
+        std::lock_guard<std::mutex> lk(mu);
+        while (ids.size() < want) {
+            // started before the next epoch bump, so it can't miss that job
+            size_t id = ids.size() + 1;
+            uint64_t e0 = epoch;
+            std::thread t([this, id, e0] { loop(id, e0); });
+            ids.push_back(t.get_id());
+            t.detach();
+        }
+    }
+
+    void loop(size_t id, uint64_t seen) {
+        g_in_parallel = true;
+        std::unique_lock<std::mutex> lk(mu);
+        for (;;) {
+            cv.wait(lk, [&] { return epoch != seen; });
+            seen = epoch;
+            if (id >= T) continue;
+
+            Job * j = job;
+            lk.unlock();
+            j->run(id);
+            lk.lock();
+            if (--left == 0) done.notify_one();
+        }
+    }
+
+    void submit(Job & j) {
+        grow(j.T - 1);
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            job = &j;
+            T = j.T;
+            left = j.T - 1;
+            ++epoch;
+        }
+        cv.notify_all();
+
+        {
+            InParallel in;
+            j.run(0);
+        }
+
+        // the job lives on the caller's stack, every worker is off it before we leave
+        {
+            std::unique_lock<std::mutex> lk(mu);
+            done.wait(lk, [&] { return left == 0; });
+            job = nullptr;
+        }
+        if (j.err) std::rethrow_exception(j.err);
+    }
+};
+
+inline std::atomic<Pool *> g_pool { nullptr };
+
+inline Pool & pool() {
+    Pool * p = g_pool.load(std::memory_order_acquire);
+    if (p) return *p;
+    Pool * q = new Pool();
+    if (g_pool.compare_exchange_strong(p, q, std::memory_order_acq_rel)) return *q;
+    delete q;
+    return *p;
+}
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+// the parent's workers don't exist in a child and its mutexes may have been
+// held by one of them at fork, leave that pool behind without touching it
+inline const bool g_pool_fork_hook = [] {
+    pthread_atfork(nullptr, nullptr, +[] { g_pool.store(nullptr, std::memory_order_relaxed); });
+    return true;
+}();
+#endif
+
+}
+
+// f(i, worker) for every i in [0, n) on the shared pool. each worker starts on
+// its own contiguous slice and steals half of the largest remaining one when it
+// runs dry, worker < parallel_width(n) for per-worker scratch
+template<typename F>
+inline void parallel_for(ExecPolicy pol, size_t n, F && f) {
+    size_t T = parallel_width(n, pol);
+
+    auto serial = [&] { for (size_t i = 0; i < n; ++i) f(i, (size_t)0); };
+    if (T <= 1 || n >= (1ull << 32)) return serial();
+
+    par::Pool & P = par::pool();
+    std::unique_lock<std::mutex> own(P.busy, std::try_to_lock);
+    if (!own.owns_lock()) return serial();
+
+    par::Job j(n, T);
+    j.ctx = (void *)&f;
+    j.call = [](void * c, size_t i, size_t w) { (*(std::remove_reference_t<F> *)c)(i, w); };
+    P.submit(j);
+}
+
+template<typename F>
+inline void parallel_for(size_t n, F && f) {
+    parallel_for(g_exec, n, std::forward<F>(f));
+}
+
+}
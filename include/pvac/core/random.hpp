@@ -4,14 +4,21 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <iostream>
+
+#include "aes_ctr.hpp"
 
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
     #include <stdlib.h>
+    #include <pthread.h>
 #elif defined(__linux__)
     #include <unistd.h>
     #include <sys/random.h>
     #include <fcntl.h>
     #include <errno.h>
+    #include <pthread.h>
 #elif defined(_WIN32)
     #define NOMINMAX
     #include <windows.h>
@@ -37,7 +44,108 @@ inline void store_le64(uint8_t * p, uint64_t x) {
     }
 }
 
+// INSECURE, benchmarks and bug replay only. with a seed set every draw below
+// comes from one aes-256-ctr stream keyed by it, so keys, nonces and ciphertexts
+// are all predictable. PVAC_DET_SEED=<n> or set_deterministic_rng turn it on.
+// parallel loops keep their threads: the caller draws in program order, and a
+// loop body that draws opens a DetTask so it gets the same values on any worker
+// at any thread count. threads started by the caller (EncPool) still interleave
+inline std::atomic<bool> g_rng_det { false };
+
+struct DetRng {
+    std::mutex mu;
+    AesCtr256 prg;
+};
+
+inline DetRng & det_rng() {
+    static DetRng r;
+    return r;
+}
+
+inline void set_deterministic_rng(uint64_t seed) {
+    uint8_t key[32];
+    for (int i = 0; i < 4; i++) {
+        // splitmix64, spreads a small seed over the key
+        seed += 0x9e3779b97f4a7c15ull;
+        uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        store_le64(key + 8 * i, z ^ (z >> 31));
+    }
+
+    DetRng & r = det_rng();
+    std::lock_guard<std::mutex> lk(r.mu);
+    r.prg.init(key, 0);
+    if (!g_rng_det.exchange(true)) std::cerr << "[pvac] deterministic rng on, INSECURE\n";
+}
+
+inline void clear_deterministic_rng() {
+    g_rng_det = false;
+}
+
+inline bool deterministic_rng() {
+    return g_rng_det.load(std::memory_order_relaxed);
+}
+
+inline const bool g_det_env = [] {
+    const char * s = std::getenv("PVAC_DET_SEED");
+    if (s) set_deterministic_rng(std::strtoull(s, nullptr, 0));
+    return s != nullptr;
+}();
+
+// stream of the DetTask open on this thread, if any
+inline thread_local AesCtr256 * g_det_task = nullptr;
+
+inline uint64_t det_u64() {
+    if (g_det_task) return g_det_task->next_u64();
+    DetRng & r = det_rng();
+    std::lock_guard<std::mutex> lk(r.mu);
+    return r.prg.next_u64();
+}
+
+// key for the DetTasks of one parallel loop, drawn on the caller before it starts
+struct DetKey {
+    uint8_t k[32];
+};
+
+inline DetKey det_task_key() {
+    DetKey d;
+    for (int i = 0; i < 4; i++) store_le64(d.k + 8 * i, det_u64());
+    return d;
+}
+
+// DetTask t(key, i); the draws of task i come from a stream keyed by (key, i)
+// until t goes away. a null key, outside deterministic mode, leaves them alone
+struct DetTask {
+    AesCtr256 prg;
+    AesCtr256 * prev = g_det_task;
+    bool on;
+
+    DetTask(const DetKey * key, uint64_t task) : on(key != nullptr) {
+        if (!on) return;
+        prg.init(key->k, task);
+        g_det_task = &prg;
+    }
+    ~DetTask() { if (on) g_det_task = prev; }
+    DetTask(const DetTask &) = delete;
+    DetTask & operator=(const DetTask &) = delete;
+};
+
+// requests to the os generator, one per csprng_bytes
+inline std::atomic<uint64_t> g_os_rng_calls { 0 };
+
 inline void csprng_bytes(uint8_t * out, size_t n) {
+    if (deterministic_rng()) {
+        for (size_t off = 0; off < n; off += 8) {
+            uint8_t b[8];
+            store_le64(b, det_u64());
+            std::memcpy(out + off, b, std::min((size_t)8, n - off));
+        }
+        return;
+    }
+
+    g_os_rng_calls.fetch_add(1, std::memory_order_relaxed);
+
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
     arc4random_buf(out, n);
 
@@ -103,7 +211,72 @@ inline void csprng_bytes(uint8_t * out, size_t n) {
 #endif
 }
 
+// csprng_u64 draws from a per-thread aes-256-ctr generator keyed by
+// csprng_bytes. every refill takes the next key from its own output first, so
+// served words can't be recovered from the state later. it goes back to the os
+// every DRBG_RESEED words and in a forked child. PVAC_OS_RNG set: one os call per word
+inline bool g_drbg = std::getenv("PVAC_OS_RNG") == nullptr;
+
+// bumped in the child after fork, generators seeded before it reseed
+inline std::atomic<uint64_t> g_fork_gen { 0 };
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+inline const bool g_fork_hook = [] {
+    pthread_atfork(nullptr, nullptr, +[] { g_fork_gen.fetch_add(1, std::memory_order_relaxed); });
+    return true;
+}();
+#endif
+
+struct Drbg {
+    static constexpr size_t N = 32;
+    static constexpr uint64_t DRBG_RESEED = 1ull << 20;
+
+    AesCtr256 prg;
+    uint64_t buf[N];
+    size_t pos = N;
+    uint64_t served = 0;
+    uint64_t gen = ~0ull;
+
+    void wipe(void * p, size_t n) {
+        volatile uint8_t * q = (volatile uint8_t *)p;
+        while (n--) *q++ = 0;
+    }
+
+    void seed() {
+        uint8_t key[32];
+        csprng_bytes(key, 32);
+        prg.init(key, 0);
+        wipe(key, 32);
+        wipe(buf, sizeof(buf));
+        pos = N;
+        served = 0;
+        gen = g_fork_gen.load(std::memory_order_relaxed);
+    }
+
+    void refill() {
+        uint64_t key[4];
+        prg.fill_u64(key, 4);
+        prg.fill_u64(buf, N);
+        prg.init((const uint8_t *)key, 0);
+        wipe(key, sizeof(key));
+        pos = 0;
+    }
+
+    uint64_t next() {
+        if (gen != g_fork_gen.load(std::memory_order_relaxed) || served >= DRBG_RESEED) seed();
+        if (pos == N) refill();
+        uint64_t x = buf[pos];
+        buf[pos++] = 0;
+        ++served;
+        return x;
+    }
+};
+
+inline thread_local Drbg g_drbg_state;
+
 inline uint64_t csprng_u64() {
+    if (deterministic_rng()) return det_u64();
+    if (g_drbg) return g_drbg_state.next();
     uint8_t b[8];
     csprng_bytes(b, 8);
     return load_le64(b);
@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <vector>
 #include <array>
+#include <unordered_map>
+#include <algorithm>
 
 #include "field.hpp"
 #include "bitvec.hpp"
@@ -32,6 +34,13 @@ namespace Dom {
 }
 
 
+// when guard_budget runs compact_edges
+enum class CompactMode : uint8_t {
+    LAZY,       // only past edge_budget or compact_max_bytes
+    ADAPTIVE,   // also once the duplicate estimate reaches compact_dup_ratio of the edges
+    EAGER       // whenever an op may have left duplicates
+};
+
 // all safety and dimensions are set, and can only be changed if there is an understanding of why
 struct Params {
 
@@ -50,6 +59,14 @@ struct Params {
     double depth_slope_bits = 16.0;
     size_t edge_budget = 1200000;
 
+    // fresh and product edges keep only their salt, sigma is rebuilt on demand
+    bool lazy_sigma = true;
+
+    // merging lazy duplicates materializes their sigma, so adaptive waits for a real share
+    CompactMode compact_mode = CompactMode::ADAPTIVE;
+    double compact_dup_ratio = 0.25;
+    size_t compact_max_bytes = (size_t)1 << 30;
+
     // sec (tau = 1/8):
     // info theor bound: 2226 bits
     // classical: 200+ bits  
@@ -111,11 +128,55 @@ struct Edge {
     uint8_t ch;
     Fp w;
     BitVec  s;
+
+    // s is empty until mat is set, the bits come from
+    // sigma_from_H(layer seed, idx, ch, salt)
+    uint64_t salt = 0;
+    bool mat = true;
+};
+
+// identity of a layer: BASE by seed, PROD by its parents in (min, max) order
+struct LayerKey {
+    uint64_t a, b, c;
+    bool operator==(const LayerKey& o) const { return a == o.a && b == o.b && c == o.c; }
+};
+
+struct LayerKeyHash {
+    size_t operator()(const LayerKey& k) const {
+        uint64_t h = k.a * 0x9E3779B97F4A7C15ull;
+        h ^= k.b + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2);
+        h ^= k.c + 0xBF58476D1CE4E5B9ull + (h << 6) + (h >> 2);
+        return (size_t)h;
+    }
+};
+
+inline LayerKey layer_key(const Layer& L) {
+    if (L.rule == RRule::BASE) return {L.seed.ztag, L.seed.nonce.lo, L.seed.nonce.hi};
+    return {~0ull, std::min(L.pa, L.pb), std::max(L.pa, L.pb)};
+}
+
+inline uint64_t bucket_key(uint32_t lid, uint16_t idx, uint8_t ch) {
+    return ((uint64_t)lid << 32) | (2u * idx + ch);
+}
+
+// lookup for in-place accumulation (ct_add_inplace): layer identity -> id and
+// (layer, idx, ch) -> edge slot. only trusted while on, anything that
+// reorders L or E drops it
+struct CipherIndex {
+    bool on = false;
+    std::unordered_map<LayerKey, uint32_t, LayerKeyHash> layer;
+    std::unordered_map<uint64_t, uint32_t> bucket;
 };
 
 struct Cipher {
     std::vector<Layer> L;
     std::vector<Edge> E;
+
+    // upper estimate of edges sharing a (layer, idx, ch) bucket with another one,
+    // carried by the ops and cleared by compact_edges
+    size_t dup_est = 0;
+
+    CipherIndex ix;
 };
 
 struct PubKey {
@@ -126,6 +187,8 @@ struct PubKey {
     std::array<uint8_t, 32> H_digest;
     Fp omega_B;
     std::vector<Fp> powg_B;
+    // optional cache of 1 / powg_B from pk_precompute, not serialized
+    std::vector<Fp> powg_inv_B;
 };
 
 struct SecKey {
@@ -32,6 +32,13 @@ inline std::vector<int> factor_small(int n) {
     return p;
 }
 
+// tables derived from the public parameters, optional: rerun after loading a
+// key to skip the per-share inversions in encryption
+inline void pk_precompute(PubKey& pk) {
+    pk.powg_inv_B.resize(pk.powg_B.size());
+    fp_inv_batch(pk.powg_B.data(), pk.powg_inv_B.data(), pk.powg_B.size());
+}
+
 inline void keygen(const Params & prm, PubKey & pk, SecKey & sk) {
     pk.prm = prm;
 
@@ -94,6 +101,8 @@ inline void keygen(const Params & prm, PubKey & pk, SecKey & sk) {
         pk.powg_B[i] = fp_mul(pk.powg_B[i - 1], g);
     }
 
+    pk_precompute(pk);
+
     auto primes = factor_small(pk.prm.B);
 
     for (;;) {
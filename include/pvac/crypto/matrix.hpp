@@ -8,6 +8,7 @@
 
 #include "../core/types.hpp"
 #include "../core/hash.hpp"
+#include "../core/parallel.hpp"
 
 namespace pvac {
 
@@ -19,34 +20,32 @@ inline std::vector<int> prg_choose_k(
     const std::vector<uint64_t> & words
 ) {
     struct Ctr {
-        const char * L;
-        std::vector<uint64_t>   w;
+        Sha256 mid;
         uint64_t ctr;
         uint8_t buf[32];
         int idx;
 
+        // label and words are the same for every block, absorb them once
         Ctr(const char * lab, const std::vector<uint64_t> & ww)
-            : L(lab), w(ww), ctr(0), idx(32) {}
+            : ctr(0), idx(32) {
+            mid.init();
+            mid.update(lab, std::strlen(lab));
 
-        void refill() {
-            uint8_t out[32];
-            Sha256 s;
-
-            s.init();
-            s.update(L, std::strlen(L));
-
-            for (uint64_t x : w) {
+            for (uint64_t x : ww) {
                 uint8_t b[8];
                 store_le64(b, x);
-                s.update(b, 8);
+                mid.update(b, 8);
             }
+        }
+
+        void refill() {
+            Sha256 s = mid;
 
             uint8_t cb[8];
             store_le64(cb, ctr++);
             s.update(cb, 8);
-            s.finish(out);
+            s.finish(buf);
 
-            std::memcpy(buf, out, 32);
             idx = 0;
         }
 
@@ -75,15 +74,16 @@ inline std::vector<int> prg_choose_k(
         }
     } rng(label, words);
 
-    std::unordered_set<int> used;
-    used.reserve((size_t)k * 2 + 1);
+    std::vector<uint64_t> used(((size_t)N + 63) / 64, 0);
 
     std::vector<int> out;
     out.reserve(k);
 
     while ((int)out.size() < k) {
         int x = (int)rng.bounded((uint64_t)N);
-        if (used.insert(x).second) {
+        uint64_t bit = 1ull << (x & 63);
+        if (!(used[(size_t)x >> 6] & bit)) {
+            used[(size_t)x >> 6] |= bit;
             out.push_back(x);
         }
     }
@@ -195,7 +195,9 @@ inline void gen_H(PubKey & pk) {
 
     pk.H.resize(n, BitVec::make(m));
 
-    for (int c = 0; c < n; c++) {
+    // columns are independent draws keyed by their index
+    parallel_for((size_t)n, [&](size_t ci, size_t) {
+        int c = (int)ci;
         BitVec col = BitVec::make(m);
 
         std::vector<uint64_t> words {
@@ -213,7 +215,7 @@ inline void gen_H(PubKey & pk) {
         }
 
         pk.H[c] = std::move(col);
-    }
+    });
 
     // digest for verif
     Sha256 s;
@@ -302,11 +304,45 @@ inline BitVec sigma_from_H(
     return s;
 }
 
+// sigma of an edge, seeded edges are rebuilt into tmp
+inline const BitVec & edge_sigma(
+    const PubKey & pk,
+    const Cipher & C,
+    const Edge & e,
+    BitVec & tmp
+) {
+    if (e.mat) {
+        return e.s;
+    }
+
+    const RSeed & sd = C.L[e.layer_id].seed;
+    tmp = sigma_from_H(pk, sd.ztag, sd.nonce, e.idx, e.ch, e.salt);
+    return tmp;
+}
+
+inline void materialize_edge(const PubKey & pk, const Cipher & C, Edge & e) {
+    if (e.mat) {
+        return;
+    }
+
+    const RSeed & sd = C.L[e.layer_id].seed;
+    e.s = sigma_from_H(pk, sd.ztag, sd.nonce, e.idx, e.ch, e.salt);
+    e.mat = true;
+}
+
+inline void materialize_sigmas(const PubKey & pk, Cipher & C) {
+    parallel_for(C.E.size(), [&](size_t i, size_t) {
+        materialize_edge(pk, C, C.E[i]);
+    });
+}
+
 // permutation to all edges in ct
 inline void ubk_apply(const PubKey & pk, Cipher & C) {
-    for (auto & e : C.E) {
+    parallel_for(C.E.size(), [&](size_t i, size_t) {
+        Edge & e = C.E[i];
+        materialize_edge(pk, C, e);
         e.s = apply_perm_sigma(e.s, pk.ubk.inv);
-    }
+    });
 }
 
 }
\ No newline at end of file
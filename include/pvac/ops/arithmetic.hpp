@@ -2,9 +2,10 @@
 
 #include <cstdint>
 #include <vector>
-#include <unordered_map>
 
 #include "../core/types.hpp"
+#include "../core/fp_vec.hpp"
+#include "../core/parallel.hpp"
 #include "encrypt.hpp"
 
 namespace pvac {
@@ -24,15 +25,82 @@ inline Cipher ct_add(const PubKey& pk, const Cipher& A, const Cipher& B) {
     
     for (const auto& e : A.E) C.E.push_back(e);
     for (auto e : B.E) { e.layer_id += off; C.E.push_back(std::move(e)); }
+    C.dup_est = A.dup_est + B.dup_est;
     
+    intern_layers(pk, C);
     guard_budget(pk, C, "add");
     compact_layers(C);
     return C;
 }
 
+// builds C.ix, the first edge of a bucket owns it
+inline void index_cipher(Cipher& C) {
+    CipherIndex& ix = C.ix;
+    ix = CipherIndex{};
+    ix.layer.reserve(C.L.size());
+    ix.bucket.reserve(C.E.size());
+
+    for (uint32_t lid = 0; lid < (uint32_t)C.L.size(); ++lid) ix.layer.emplace(layer_key(C.L[lid]), lid);
+    for (uint32_t i = 0; i < (uint32_t)C.E.size(); ++i) {
+        const Edge& e = C.E[i];
+        ix.bucket.emplace(bucket_key(e.layer_id, e.idx, e.ch), i);
+    }
+    ix.on = true;
+}
+
+// A += B without growing A's buckets: B's layers are looked up by identity,
+// B's edges are folded into the bucket they hit (w summed, sigma xored) or
+// appended. O(|B.L| + |B.E|) once A is indexed
+inline void ct_add_inplace(const PubKey& pk, Cipher& A, const Cipher& B) {
+    if (!A.ix.on) index_cipher(A);
+    CipherIndex& ix = A.ix;
+
+    std::vector<uint32_t> lmap(B.L.size());
+    for (uint32_t l = 0; l < (uint32_t)B.L.size(); ++l) {
+        Layer Lr = B.L[l];
+        if (Lr.rule == RRule::PROD) {
+            if (Lr.pa >= l || Lr.pb >= l) std::abort();
+            Lr.pa = lmap[Lr.pa];
+            Lr.pb = lmap[Lr.pb];
+        }
+
+        auto it = ix.layer.emplace(layer_key(Lr), (uint32_t)A.L.size());
+        if (it.second) A.L.push_back(Lr);
+        lmap[l] = it.first->second;
+    }
+
+    BitVec t;
+    for (const auto& e : B.E) {
+        uint32_t lid = lmap[e.layer_id];
+        auto it = ix.bucket.emplace(bucket_key(lid, e.idx, e.ch), (uint32_t)A.E.size());
+
+        if (!it.second) {
+            Edge& d = A.E[it.first->second];
+            materialize_edge(pk, A, d);
+            d.w = fp_add(d.w, e.w);
+            d.s.xor_with(edge_sigma(pk, B, e, t));
+            continue;
+        }
+
+        // a lazy edge keeps its salt only if the layer it lands on has its seed
+        Edge n = e;
+        const RSeed& a = A.L[lid].seed;
+        const RSeed& b = B.L[e.layer_id].seed;
+        if (a.ztag != b.ztag || a.nonce.lo != b.nonce.lo || a.nonce.hi != b.nonce.hi) materialize_edge(pk, B, n);
+        n.layer_id = lid;
+        A.E.push_back(std::move(n));
+    }
+}
+
 inline Cipher ct_scale(const PubKey&, const Cipher& A, const Fp& s) {
     Cipher C = A;
-    for (auto& e : C.E) e.w = fp_mul(e.w, s);
+    Fp w[FP_VEC_CHUNK];
+    for (size_t i = 0; i < C.E.size(); i += FP_VEC_CHUNK) {
+        size_t k = std::min(FP_VEC_CHUNK, C.E.size() - i);
+        for (size_t j = 0; j < k; j++) w[j] = C.E[i + j].w;
+        fp_mul_vec(w, s, w, k);
+        for (size_t j = 0; j < k; j++) C.E[i + j].w = w[j];
+    }
     return C;
 }
 
@@ -44,62 +112,193 @@ inline Cipher ct_sub(const PubKey& pk, const Cipher& A, const Cipher& B) {
     return ct_add(pk, A, ct_neg(pk, B));
 }
 
+// edges of X grouped by layer, only layers that carry edges, in layer order
+struct LayerEdges {
+    std::vector<uint32_t> lid;
+    std::vector<uint32_t> start;
+    std::vector<uint32_t> eid;
+};
+
+inline LayerEdges group_by_layer(const Cipher& X) {
+    LayerEdges g;
+    std::vector<uint32_t> cnt(X.L.size() + 1, 0);
+    for (const auto& e : X.E) ++cnt[e.layer_id];
+
+    std::vector<uint32_t> pos(X.L.size(), 0);
+    g.start.push_back(0);
+    for (uint32_t l = 0; l < (uint32_t)X.L.size(); ++l) {
+        if (!cnt[l]) continue;
+        pos[l] = g.start.back();
+        g.lid.push_back(l);
+        g.start.push_back(g.start.back() + cnt[l]);
+    }
+
+    g.eid.resize(X.E.size());
+    for (uint32_t i = 0; i < (uint32_t)X.E.size(); ++i) g.eid[pos[X.E[i].layer_id]++] = i;
+    return g;
+}
+
+// surviving (idx, sign) bucket of one product layer
+struct ProdOut {
+    uint16_t idx;
+    uint8_t ch;
+    Fp w;
+};
+
+// bucket k keeps same-sign products in pos and mixed-sign ones in neg,
+// each lane is reduced once here and becomes its own edge
+inline void prod_flush(const std::vector<FpAcc>& acc, int Bmod, std::vector<ProdOut>& out) {
+    auto used = [](const uint64_t* w) { return (w[0] | w[1] | w[2] | w[3] | w[4]) != 0; };
+
+    for (int k = 0; k < Bmod; ++k) {
+        if (used(acc[k].pos)) {
+            Fp w = fp_acc_pos(acc[k]);
+            if (ct::fp_is_nonzero(w)) out.push_back({(uint16_t)k, SGN_P, w});
+        }
+        if (used(acc[k].neg)) {
+            Fp w = fp_acc_neg(acc[k]);
+            if (ct::fp_is_nonzero(w)) out.push_back({(uint16_t)k, SGN_M, w});
+        }
+    }
+}
+
+inline Layer prod_layer(const PubKey& pk, uint32_t pa, uint32_t pb) {
+    Layer L;
+    L.rule = RRule::PROD;
+    L.pa = pa;
+    L.pb = pb;
+    L.seed.nonce = make_nonce128();
+    L.seed.ztag = prg_layer_ztag(pk.canon_tag, L.seed.nonce);
+    return L;
+}
+
+// product layer base + p gets outs[p]; salts are drawn here in layer order,
+// so the rng is only touched by the caller
+inline void prod_emit(const PubKey& pk, Cipher& C, uint32_t base, std::vector<std::vector<ProdOut>>& outs) {
+    size_t total = 0;
+    for (const auto& o : outs) total += o.size();
+    C.E.reserve(C.E.size() + total);
+
+    size_t first = C.E.size();
+    for (size_t p = 0; p < outs.size(); ++p) {
+        uint32_t lid = base + (uint32_t)p;
+        for (const auto& o : outs[p]) C.E.push_back({lid, o.idx, o.ch, o.w, BitVec::make(0), csprng_u64(), false});
+        std::vector<ProdOut>().swap(outs[p]);
+    }
+
+    if (!pk.prm.lazy_sigma) {
+        parallel_for(C.E.size() - first, [&](size_t k, size_t) { materialize_edge(pk, C, C.E[first + k]); });
+    }
+}
+
+// A*A over A's own layers: one PROD layer per unordered pair la <= lb,
+// cross terms counted once with weight 2*wa*wb
+inline Cipher ct_sqr(const PubKey& pk, const Cipher& A) {
+    Cipher C;
+    C.L = A.L;
+
+    LayerEdges ga = group_by_layer(A);
+    uint32_t NA = (uint32_t)ga.lid.size();
+
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    pairs.reserve((size_t)NA * (NA + 1) / 2);
+    for (uint32_t i = 0; i < NA; ++i)
+        for (uint32_t j = i; j < NA; ++j) pairs.push_back({i, j});
+
+    uint32_t base = (uint32_t)C.L.size();
+    for (const auto& pr : pairs) C.L.push_back(prod_layer(pk, ga.lid[pr.first], ga.lid[pr.second]));
+
+    int Bmod = pk.prm.B;
+    Fp two = fp_from_u64(2);
+    std::vector<std::vector<ProdOut>> outs(pairs.size());
+    std::vector<std::vector<FpAcc>> scratch(parallel_width(pairs.size()), std::vector<FpAcc>((size_t)Bmod));
+
+    parallel_for(pairs.size(), [&](size_t pr, size_t w) {
+        uint32_t i = pairs[pr].first, j = pairs[pr].second;
+        std::vector<FpAcc>& acc = scratch[w];
+        std::fill(acc.begin(), acc.end(), FpAcc{});
+
+        for (uint32_t p = ga.start[i]; p < ga.start[i + 1]; ++p) {
+            const Edge& ea = A.E[ga.eid[p]];
+            Fp wa2 = fp_mul(ea.w, two);
+
+            // on the diagonal the (q, p) term is folded into (p, q)
+            uint32_t q0 = ga.start[j];
+            if (i == j) {
+                int k = 2 * ea.idx;
+                if (k >= Bmod) k -= Bmod;
+                fp_acc_muladd(acc[k], ea.w, ea.w);
+                q0 = p + 1;
+            }
+
+            for (uint32_t q = q0; q < ga.start[j + 1]; ++q) {
+                const Edge& eb = A.E[ga.eid[q]];
+                int k = ea.idx + eb.idx;
+                if (k >= Bmod) k -= Bmod;
+                if (ea.ch == eb.ch) fp_acc_muladd(acc[k], wa2, eb.w);
+                else fp_acc_mulsub(acc[k], wa2, eb.w);
+            }
+        }
+
+        prod_flush(acc, Bmod, outs[pr]);
+    });
+
+    prod_emit(pk, C, base, outs);
+
+    guard_budget(pk, C, "sqr");
+    compact_layers(C);
+    return C;
+}
+
 inline Cipher ct_mul(const PubKey& pk, const Cipher& A, const Cipher& B) {
+    if (&A == &B) return ct_sqr(pk, A);
+
     Cipher C;
     
     for (const auto& L : A.L) C.L.push_back(L);
     uint32_t off = (uint32_t)C.L.size();
-    uint32_t LA = (uint32_t)A.L.size(), LB = (uint32_t)B.L.size();
     
     for (auto L : B.L) {
         if (L.rule == RRule::PROD) { L.pa += off; L.pb += off; }
         C.L.push_back(L);
     }
     
+    // a product layer can only get edges if both parents carry some
+    LayerEdges ga = group_by_layer(A), gb = group_by_layer(B);
+    uint32_t NA = (uint32_t)ga.lid.size(), NB = (uint32_t)gb.lid.size();
+
     uint32_t base = (uint32_t)C.L.size();
-    for (uint32_t la = 0; la < LA; ++la) {
-        for (uint32_t lb = 0; lb < LB; ++lb) {
-            Layer L;
-            L.rule = RRule::PROD;
-            L.pa = la;
-            L.pb = off + lb;
-            L.seed.nonce = make_nonce128();
-            L.seed.ztag = prg_layer_ztag(pk.canon_tag, L.seed.nonce);
-            C.L.push_back(L);
-        }
-    }
+    for (uint32_t i = 0; i < NA; ++i)
+        for (uint32_t j = 0; j < NB; ++j) C.L.push_back(prod_layer(pk, ga.lid[i], off + gb.lid[j]));
     
-    struct Agg { Fp wp{}, wm{}; bool ip = false, im = false; };
-    struct H { size_t operator()(uint64_t x) const noexcept { return x * 0x9E3779B97F4A7C15ull; } };
-    
-    std::unordered_map<uint64_t, Agg, H> acc;
-    acc.reserve(A.E.size() * B.E.size());
+    // one task per layer pair, each worker owns a dense idx table of unreduced sums
     int Bmod = pk.prm.B;
-    
-    for (const auto& ea : A.E) {
-        for (const auto& eb : B.E) {
-            uint64_t k = ((uint64_t)(ea.layer_id * LB + eb.layer_id) << 32) | ((ea.idx + eb.idx) % Bmod);
-            Agg& a = acc[k];
-            Fp ww = fp_mul(ea.w, eb.w);
-            (ea.ch == eb.ch)
-                ? (a.ip || (a.wp = fp_from_u64(0), a.ip = true), a.wp = fp_add(a.wp, ww))
-                : (a.im || (a.wm = fp_from_u64(0), a.im = true), a.wm = fp_add(a.wm, ww));
+    size_t npair = (size_t)NA * NB;
+    std::vector<std::vector<ProdOut>> outs(npair);
+    std::vector<std::vector<FpAcc>> scratch(parallel_width(npair), std::vector<FpAcc>((size_t)Bmod));
+
+    parallel_for(npair, [&](size_t pr, size_t w) {
+        uint32_t i = (uint32_t)(pr / NB), j = (uint32_t)(pr % NB);
+        std::vector<FpAcc>& acc = scratch[w];
+        std::fill(acc.begin(), acc.end(), FpAcc{});
+
+        for (uint32_t p = ga.start[i]; p < ga.start[i + 1]; ++p) {
+            const Edge& ea = A.E[ga.eid[p]];
+            for (uint32_t q = gb.start[j]; q < gb.start[j + 1]; ++q) {
+                const Edge& eb = B.E[gb.eid[q]];
+                int k = ea.idx + eb.idx;
+                if (k >= Bmod) k -= Bmod;
+                if (ea.ch == eb.ch) fp_acc_muladd(acc[k], ea.w, eb.w);
+                else fp_acc_mulsub(acc[k], ea.w, eb.w);
+            }
         }
-    }
-    
-    auto emit = [&](uint32_t lid, uint16_t idx, uint8_t ch, const Fp& w) {
-        const Layer& Lp = C.L[lid];
-        C.E.push_back(Edge{lid, idx, ch, w,
-            sigma_from_H(pk, Lp.seed.ztag, Lp.seed.nonce, idx, ch, csprng_u64())});
-    };
-    
-    for (const auto& [k, a] : acc) {
-        uint32_t lid = base + (uint32_t)(k >> 32);
-        uint16_t idx = (uint16_t)(k & 0xFFFF);
-        if (a.ip && ct::fp_is_nonzero(a.wp)) emit(lid, idx, SGN_P, a.wp);
-        if (a.im && ct::fp_is_nonzero(a.wm)) emit(lid, idx, SGN_M, a.wm);
-    }
+
+        prod_flush(acc, Bmod, outs[pr]);
+    });
+
+    prod_emit(pk, C, base, outs);
     
+    intern_layers(pk, C);
     guard_budget(pk, C, "mul");
     compact_layers(C);
     return C;
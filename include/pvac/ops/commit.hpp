@@ -6,6 +6,7 @@
 
 #include "../core/types.hpp"
 #include "../core/hash.hpp"
+#include "../crypto/matrix.hpp"
 
 namespace pvac {
 
@@ -37,6 +38,8 @@ inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C)
         }
     }
 
+    BitVec tmp;
+
     for (const auto & e : C.E) {
         sha256_acc_u64(s, e.layer_id);
         sha256_acc_u64(s, e.idx);
@@ -57,20 +60,22 @@ inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C)
 
         s.update(w16, 16);
 
-        size_t bytes = (e.s.nbits + 7) / 8;
+        const BitVec & sg = edge_sigma(pk, C, e, tmp);
+
+        size_t bytes = (sg.nbits + 7) / 8;
         size_t full  = bytes / 8;
         size_t rem   = bytes % 8;
 
         for (size_t i = 0; i < full; i++) {
             uint8_t b[8];
-            store_le64(b, e.s.w[i]);
+            store_le64(b, sg.w[i]);
             s.update(b, 8);
         }
 
         if (rem) {
             uint8_t b[8];
 
-            uint64_t x = e.s.w[full];
+            uint64_t x = sg.w[full];
 
             for (size_t j = 0; j < rem; j++) {
                 b[j] = (uint8_t)((x >> (8 * j)) & 0xFF);
@@ -2,91 +2,290 @@
 
 #include <cstdint>
 #include <vector>
+#include <list>
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
 
 #include "../core/types.hpp"
+#include "../core/fp_vec.hpp"
+#include "../core/parallel.hpp"
 #include "../crypto/lpn.hpp"
 
 namespace pvac {
 
-inline Fp layer_R_cached(
-    const PubKey & pk,
-    const SecKey & sk,
-    const Cipher & C,
-    uint32_t lid,
-    std::vector<int> & vis,
-    std::vector<Fp> & cache
-
-) {
-    if ((size_t)lid >= C.L.size()) {
+// marks the layers that carry edges or feed one in a reverse sweep and
+// returns the needed BASE layers, highest first
+inline std::vector<uint32_t> layer_need(const Cipher & C, std::vector<uint8_t> & need) {
+    size_t L = C.L.size();
+    need.assign(L, 0);
 
-        std::abort();
+    for (const auto & e : C.E) {
+        if (e.layer_id >= L) {
+            std::cerr << "[R] bad layer\n";
+            std::abort();
+        }
+        need[e.layer_id] = 1;
     }
 
-    if (cache[lid].lo | cache[lid].hi) 
-    
-    {
-        return cache[lid];
-    }
+    std::vector<uint32_t> base;
+    for (size_t l = L; l-- > 0; ) {
+        const Layer & Lr = C.L[l];
+        if (!need[l]) continue;
 
-    if (vis[lid]) 
-    {
-       
-        std::cerr << "[R] cycle\n";
-        std::abort();
+        if (Lr.rule == RRule::BASE) {
+            base.push_back((uint32_t)l);
+        } else {
+            if (Lr.pa >= l || Lr.pb >= l) {
+                std::cerr << "[R] bad parent\n";
+                std::abort();
+            }
+            need[Lr.pa] = 1;
+            need[Lr.pb] = 1;
+        }
     }
+    return base;
+}
 
-    vis[lid] = 1;
+// prf_R of every seed. the three prf_R_core draws of a seed are separate
+// tasks, a fresh ciphertext has only a couple of BASE layers
+inline std::vector<Fp> prf_R_many(const PubKey & pk, const SecKey & sk, const std::vector<RSeed> & seeds) {
+    // pick the toeplitz kernel before workers race to do it
+    if (!g_toep) select_toeplitz();
 
-    const Layer & L = C.L[lid];
-    Fp R {};
+    static const char * const dom[3] = { Dom::PRF_R1, Dom::PRF_R2, Dom::PRF_R3 };
+    std::vector<Fp> part(3 * seeds.size());
+    parallel_for(part.size(), [&](size_t i, size_t) {
+        part[i] = prf_R_core(pk, sk, seeds[i / 3], dom[i % 3]);
+    });
 
-    if (L.rule == RRule::BASE) {
-        R = prf_R(pk, sk, L.seed);
-    } else {
+    // same product order as prf_R
+    std::vector<Fp> R(seeds.size());
+    for (size_t i = 0; i < seeds.size(); i++) R[i] = fp_mul(fp_mul(part[3 * i], part[3 * i + 1]), part[3 * i + 2]);
+    return R;
+}
 
-        Fp Ra = layer_R_cached(pk, sk, C, L.pa, vis, cache);
+// forward pass over needed PROD layers once every needed BASE entry of R is set
+inline void layer_R_resolve(const Cipher & C, const std::vector<uint8_t> & need, std::vector<Fp> & R) {
+    size_t L = C.L.size();
+    std::vector<uint8_t> done(L, 0);
+    for (size_t l = 0; l < L; l++) done[l] = need[l] && C.L[l].rule == RRule::BASE;
 
+    for (size_t l = 0; l < L; l++) {
+        const Layer & Lr = C.L[l];
+        if (!need[l] || Lr.rule != RRule::PROD) continue;
 
-        // test here later ( rb)
-        Fp Rb = layer_R_cached(pk, sk, C, L.pb, vis, cache);
-        R = fp_mul(Ra, Rb);
+        if (!done[Lr.pa] || !done[Lr.pb]) {
+            std::cerr << "[R] parent not computed\n";
+            std::abort();
+        }
+        R[l] = fp_mul(R[Lr.pa], R[Lr.pb]);
+        done[l] = 1;
     }
+}
+
+// R of every layer that carries edges or feeds one, without recursion: BASE
+// layers through the PRF in parallel, then PROD layers in one forward pass
+// since parents always sit below a child. layers nobody needs stay 0
+inline std::vector<Fp> layer_R_all(const PubKey & pk, const SecKey & sk, const Cipher & C) {
+    std::vector<uint8_t> need;
+    std::vector<uint32_t> base = layer_need(C, need);
 
-    vis[lid] = 0;
-    cache[lid] = R;
+    std::vector<RSeed> seeds;
+    seeds.reserve(base.size());
+    for (uint32_t l : base) seeds.push_back(C.L[l].seed);
 
+    std::vector<Fp> Rb = prf_R_many(pk, sk, seeds);
+
+    std::vector<Fp> R(C.L.size(), fp_from_u64(0));
+    for (size_t i = 0; i < base.size(); i++) R[base[i]] = Rb[i];
+
+    layer_R_resolve(C, need, R);
     return R;
 }
 
-inline Fp dec_value(const PubKey & pk, const SecKey & sk, const Cipher & C) {
-    size_t L = C.L.size();
+// T[l] = sum over layer l of +-w * g^idx. edges are visited in (layer, idx)
+// order, counting-sorted unless compaction already left them so, and every
+// (layer, idx) bucket is summed first and costs one product. duplicates spread
+// over a ct_add concatenation land in the same bucket. the products go through
+// fp_muladd_vec a layer run at a time
+inline std::vector<Fp> layer_gsums(const PubKey & pk, const Cipher & C) {
+    const auto & E = C.E;
+    const size_t n = E.size();
+    const size_t L = C.L.size();
+    std::vector<Fp> T(L, fp_from_u64(0));
+    if (n == 0) return T;
 
-    std::vector<Fp> cache(L, fp_from_u64(0));
-    std::vector<int> vis(L, 0);
+    auto before = [](const Edge & a, const Edge & b) {
+        return a.layer_id != b.layer_id ? a.layer_id < b.layer_id : a.idx < b.idx;
+    };
 
-    std::vector<Fp> Rinv(L, fp_from_u64(0));
+    std::vector<uint32_t> ord(n);
+    bool sorted = true;
+    for (size_t i = 1; i < n && sorted; ++i) sorted = !before(E[i], E[i - 1]);
 
-    for (size_t lid = 0; lid < L; lid++) {
-         Fp R  = layer_R_cached(pk, sk, C, (uint32_t)lid, vis, cache);
-        Rinv[lid] = fp_inv(R);
+    if (sorted) {
+        for (uint32_t i = 0; i < (uint32_t)n; ++i) ord[i] = i;
+    } else {
+        // by idx, then stably by layer
+        const size_t B = (size_t)pk.prm.B;
+        std::vector<uint32_t> tmp(n), cnt(std::max(B, L) + 1, 0);
+        for (const auto & e : E) ++cnt[e.idx + 1];
+        for (size_t k = 0; k < B; ++k) cnt[k + 1] += cnt[k];
+        for (uint32_t i = 0; i < (uint32_t)n; ++i) tmp[cnt[E[i].idx]++] = i;
+
+        std::fill(cnt.begin(), cnt.end(), 0);
+        for (const auto & e : E) ++cnt[e.layer_id + 1];
+        for (size_t l = 0; l < L; ++l) cnt[l + 1] += cnt[l];
+        for (uint32_t i : tmp) ord[cnt[E[i].layer_id]++] = i;
     }
 
-    Fp acc = fp_from_u64(0);
+    Fp w[FP_VEC_CHUNK], g[FP_VEC_CHUNK];
+    size_t k = 0;
+    uint32_t cur = 0;
 
-    for (const auto & e : C.E) {
-        Fp term = fp_mul(e.w, pk.powg_B[e.idx]);
-        term = fp_mul(term, Rinv[e.layer_id]);
+    for (size_t i = 0; i < n; ) {
+        const Edge & e = E[ord[i]];
+        if (k == FP_VEC_CHUNK || (k && e.layer_id != cur)) {
+            T[cur] = fp_muladd_vec(w, g, k, T[cur]);
+            k = 0;
+        }
+        cur = e.layer_id;
 
-        if (e.ch == SGN_P) {
-            acc = fp_add(acc, term);
-        } else {
-            acc = fp_sub(acc, term);
+        Fp s = e.ch == SGN_P ? e.w : fp_neg(e.w);
+        size_t j = i + 1;
+        for (; j < n && E[ord[j]].layer_id == cur && E[ord[j]].idx == e.idx; ++j) {
+            const Edge & x = E[ord[j]];
+            s = x.ch == SGN_P ? fp_add(s, x.w) : fp_sub(s, x.w);
         }
+
+        w[k] = s;
+        g[k] = pk.powg_B[e.idx];
+        ++k;
+        i = j;
     }
+    if (k) T[cur] = fp_muladd_vec(w, g, k, T[cur]);
+
+    return T;
+}
+
+inline Fp dec_value(const PubKey & pk, const SecKey & sk, const Cipher & C) {
+    size_t L = C.L.size();
+
+    std::vector<Fp> Rinv = layer_R_all(pk, sk, C);
+    fp_inv_batch_ct(Rinv.data(), Rinv.data(), L);
 
-    return acc;
+    std::vector<Fp> T = layer_gsums(pk, C);
+    return fp_muladd_vec(T.data(), Rinv.data(), L, fp_from_u64(0));
 }
 
+// decryption bound to one key pair with a bounded LRU of BASE prf_R values
+// keyed by (ztag, nonce), so inputs shared across calls are evaluated once.
+// pk and sk must outlive it; not safe for concurrent use
+struct Decryptor {
+    const PubKey & pk;
+    const SecKey & sk;
+    size_t cap;
+
+    size_t hits = 0;
+    size_t misses = 0;
+
+    std::list<std::pair<LayerKey, Fp>> lru;
+    std::unordered_map<LayerKey, std::list<std::pair<LayerKey, Fp>>::iterator, LayerKeyHash> map;
+
+    Decryptor(const PubKey & pk_, const SecKey & sk_, size_t cap_ = 1 << 16)
+        : pk(pk_), sk(sk_), cap(std::max<size_t>(1, cap_)) {}
+
+    size_t size() const { return map.size(); }
+
+    void clear() {
+        lru.clear();
+        map.clear();
+        hits = misses = 0;
+    }
+
+    Fp dec_value(const Cipher & C) {
+        return dec_values(&C, 1)[0];
+    }
+
+    std::vector<Fp> dec_values(const std::vector<Cipher> & Cs) {
+        return dec_values(Cs.data(), Cs.size());
+    }
+
+    // every BASE seed of the batch is deduplicated and looked up before any
+    // PRF runs, the misses are evaluated together, and the whole batch shares
+    // one inversion
+    std::vector<Fp> dec_values(const Cipher * Cs, size_t n) {
+        std::vector<std::vector<uint8_t>> need(n);
+        std::vector<std::vector<uint32_t>> base(n);
+        std::vector<size_t> off(n + 1, 0);
+
+        std::unordered_map<LayerKey, uint32_t, LayerKeyHash> slot;
+        std::vector<Fp> val;
+        std::vector<RSeed> miss;
+        std::vector<uint32_t> miss_slot;
+
+        for (size_t i = 0; i < n; i++) {
+            base[i] = layer_need(Cs[i], need[i]);
+            off[i + 1] = off[i] + Cs[i].L.size();
 
-}
\ No newline at end of file
+            for (uint32_t l : base[i]) {
+                LayerKey k = layer_key(Cs[i].L[l]);
+                if (!slot.emplace(k, (uint32_t)val.size()).second) continue;
+
+                auto it = map.find(k);
+                if (it != map.end()) {
+                    lru.splice(lru.begin(), lru, it->second);
+                    val.push_back(it->second->second);
+                    ++hits;
+                } else {
+                    miss_slot.push_back((uint32_t)val.size());
+                    miss.push_back(Cs[i].L[l].seed);
+                    val.push_back(fp_from_u64(0));
+                    ++misses;
+                }
+            }
+        }
+
+        std::vector<Fp> fresh = prf_R_many(pk, sk, miss);
+        for (size_t j = 0; j < miss.size(); j++) {
+            val[miss_slot[j]] = fresh[j];
+            put(LayerKey { miss[j].ztag, miss[j].nonce.lo, miss[j].nonce.hi }, fresh[j]);
+        }
+
+        std::vector<Fp> Rinv(off[n], fp_from_u64(0));
+        parallel_for(n, [&](size_t i, size_t) {
+            const Cipher & C = Cs[i];
+            std::vector<Fp> R(C.L.size(), fp_from_u64(0));
+            for (uint32_t l : base[i]) R[l] = val[slot.find(layer_key(C.L[l]))->second];
+            layer_R_resolve(C, need[i], R);
+            std::copy(R.begin(), R.end(), Rinv.begin() + off[i]);
+        });
+
+        fp_inv_batch_ct(Rinv.data(), Rinv.data(), Rinv.size());
+
+        std::vector<Fp> out(n);
+        parallel_for(n, [&](size_t i, size_t) {
+            std::vector<Fp> T = layer_gsums(pk, Cs[i]);
+            out[i] = fp_muladd_vec(T.data(), Rinv.data() + off[i], T.size(), fp_from_u64(0));
+        });
+        return out;
+    }
+
+    void put(const LayerKey & k, const Fp & v) {
+        auto it = map.find(k);
+        if (it != map.end()) {
+            it->second->second = v;
+            lru.splice(lru.begin(), lru, it->second);
+            return;
+        }
+        lru.emplace_front(k, v);
+        map.emplace(k, lru.begin());
+        if (map.size() > cap) {
+            map.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+};
+
+}
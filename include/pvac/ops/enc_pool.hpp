@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "../core/types.hpp"
+#include "encrypt.hpp"
+
+namespace pvac {
+
+// an encryption of 0 plus the edge that takes the plaintext, w[pos] += v * k
+struct PreCipher {
+    Cipher C;
+    size_t pos = 0;
+    Fp k {};
+};
+
+// offline half of enc_value_depth: both shares, the PRFs, the noise groups and
+// every sigma. the mask share is built for v = 0, so enc_finish only patches
+inline PreCipher enc_pre(const PubKey& pk, const SecKey& sk, int depth_hint) {
+    for (;;) {
+        Fp mask = rand_fp_nonzero();
+        EncPatch p;
+        Cipher a = enc_fp_depth(pk, sk, mask, depth_hint, &p);
+        Cipher b = enc_fp_depth(pk, sk, fp_neg(mask), depth_hint);
+
+        PreCipher P;
+        P.C = combine_ciphers(pk, a, b);
+        P.k = p.k;
+
+        // after compaction (layer, idx, ch) is unique, so this finds the last
+        // share or the edge it was merged into
+        for (size_t i = 0; i < P.C.E.size(); i++) {
+            const Edge& e = P.C.E[i];
+            const Layer& L = P.C.L[e.layer_id];
+            if (e.idx != p.idx || e.ch != p.ch || L.rule != RRule::BASE) continue;
+            if (L.seed.nonce.lo != p.seed.nonce.lo || L.seed.nonce.hi != p.seed.nonce.hi) continue;
+            P.pos = i;
+            return P;
+        }
+        // merged away to nothing, draw again
+    }
+}
+
+inline Cipher enc_finish(PreCipher&& P, const Fp& v) {
+    Edge& e = P.C.E[P.pos];
+    e.w = fp_add(e.w, fp_mul(v, P.k));
+    return std::move(P.C);
+}
+
+// pool of pre-ciphertexts kept at `target` by a background thread, so the
+// online enc_value is one field product and a move. an empty pool falls back
+// to a full encryption. every pre-ciphertext is handed out once.
+// pk and sk must outlive it
+struct EncPool {
+    const PubKey& pk;
+    const SecKey& sk;
+    size_t target;
+    int depth_hint;
+
+    size_t served = 0;
+    size_t fallback = 0;
+
+    std::deque<PreCipher> q;
+    std::mutex mu;
+    std::condition_variable cv;
+    std::thread th;
+    bool stop = false;
+
+    EncPool(const PubKey& pk_, const SecKey& sk_, size_t target_, int depth_hint_ = 0, bool background = true)
+        : pk(pk_), sk(sk_), target(target_), depth_hint(depth_hint_) {
+        if (!g_toep) select_toeplitz();
+        if (background) th = std::thread([this] { refill(); });
+    }
+
+    ~EncPool() {
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            stop = true;
+        }
+        cv.notify_all();
+        if (th.joinable()) th.join();
+    }
+
+    EncPool(const EncPool&) = delete;
+    EncPool& operator=(const EncPool&) = delete;
+
+    size_t size() {
+        std::lock_guard<std::mutex> lk(mu);
+        return q.size();
+    }
+
+    // top up to target on the calling thread
+    void fill() {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lk(mu);
+                if (q.size() >= target) return;
+            }
+            PreCipher P = enc_pre(pk, sk, depth_hint);
+            std::lock_guard<std::mutex> lk(mu);
+            q.push_back(std::move(P));
+        }
+    }
+
+    Cipher enc_fp(const Fp& v) {
+        std::unique_lock<std::mutex> lk(mu);
+        ++served;
+        if (q.empty()) {
+            ++fallback;
+            lk.unlock();
+            return enc_finish(enc_pre(pk, sk, depth_hint), v);
+        }
+        PreCipher P = std::move(q.front());
+        q.pop_front();
+        lk.unlock();
+        cv.notify_one();
+        return enc_finish(std::move(P), v);
+    }
+
+    Cipher enc_value(uint64_t v) {
+        return enc_fp(fp_from_u64(v));
+    }
+
+    void refill() {
+        std::unique_lock<std::mutex> lk(mu);
+        for (;;) {
+            cv.wait(lk, [&] { return stop || q.size() < target; });
+            if (stop) return;
+
+            lk.unlock();
+            PreCipher P = enc_pre(pk, sk, depth_hint);
+            lk.lock();
+            q.push_back(std::move(P));
+        }
+    }
+};
+
+}
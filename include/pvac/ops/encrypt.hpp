@@ -2,11 +2,17 @@
 
 #include <cstdint>
 #include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
 #include <vector>
 #include <unordered_set>
+#include <unordered_map>
 #include <utility>
+#include <mutex>
 
 #include "../core/types.hpp"
+#include "../core/parallel.hpp"
 #include "../crypto/lpn.hpp"
 #include "../crypto/matrix.hpp"
 #include "../core/ct_safe.hpp"
@@ -26,93 +32,307 @@ inline std::pair<int,int> plan_noise(const PubKey& pk, int depth_hint) {
     return {z2, z3};
 }
 
+// lazy sigmas are prf output and cost a full sigma_from_H each to rebuild, so
+// statistics count materialized edges exactly and lazy ones from an even stride
+// of at most SIGMA_SAMPLE, each sampled edge weighted by how many it stands for
+inline constexpr size_t SIGMA_SAMPLE = 64;
+
+inline void sigma_stat_edges(const Cipher& C, std::vector<uint32_t>& ids, std::vector<double>& wt) {
+    size_t nlazy = 0;
+    for (const auto& e : C.E) nlazy += !e.mat;
+
+    size_t step = nlazy > SIGMA_SAMPLE ? (nlazy + SIGMA_SAMPLE - 1) / SIGMA_SAMPLE : 1;
+    size_t picked = (nlazy + step - 1) / step;
+    double lw = picked ? (double)nlazy / picked : 0.0;
+
+    ids.clear();
+    wt.clear();
+    size_t k = 0;
+    for (uint32_t i = 0; i < (uint32_t)C.E.size(); ++i) {
+        if (C.E[i].mat) { ids.push_back(i); wt.push_back(1.0); }
+        else if (k++ % step == 0) { ids.push_back(i); wt.push_back(lw); }
+    }
+}
+
 inline double sigma_density(const PubKey& pk, const Cipher& C) {
     if (C.E.empty()) return 0.0;
-    long double ones = 0, total = 0;
-    for (const auto& e : C.E) {
-        ones += e.s.popcnt();
-        total += pk.prm.m_bits;
-    }
-    return (double)(ones / total);
+
+    std::vector<uint32_t> ids;
+    std::vector<double> wt;
+    sigma_stat_edges(C, ids, wt);
+
+    std::vector<double> ones(parallel_width(ids.size()), 0.0);
+    parallel_for(ids.size(), [&](size_t i, size_t w) {
+        BitVec tmp;
+        ones[w] += wt[i] * edge_sigma(pk, C, C.E[ids[i]], tmp).popcnt();
+    });
+
+    double sum = 0;
+    for (double x : ones) sum += x;
+    return sum / ((double)C.E.size() * pk.prm.m_bits);
 }
 
+// merge edges sharing (layer, idx, ch): w summed, sigma xored. edge ids are
+// counting-sorted by (idx, ch) then layer, so scratch is O(E + L + B) and the
+// output comes out in (layer, idx, ch) order. runs are merged in parallel
+// over chunks of whole layers
 inline void compact_edges(const PubKey& pk, Cipher& C) {
-    int B = pk.prm.B;
-    size_t L = C.L.size();
+    const size_t n = C.E.size();
+    const size_t L = C.L.size();
+    const uint32_t K = 2 * (uint32_t)pk.prm.B;
+    if (n == 0) return;
+
+    auto sub = [](const Edge& e) { return 2u * e.idx + (e.ch != SGN_P); };
+
+    std::vector<uint32_t> tmp(n), ord(n);
+    std::vector<uint32_t> cnt(K + 1, 0);
+    for (const auto& e : C.E) ++cnt[sub(e) + 1];
+    for (uint32_t k = 0; k < K; ++k) cnt[k + 1] += cnt[k];
+    for (uint32_t i = 0; i < (uint32_t)n; ++i) tmp[cnt[sub(C.E[i])]++] = i;
+
+    std::vector<uint32_t> lstart(L + 1, 0);
+    for (const auto& e : C.E) ++lstart[e.layer_id + 1];
+    for (size_t l = 0; l < L; ++l) lstart[l + 1] += lstart[l];
+    cnt.assign(lstart.begin(), lstart.end() - 1);
+    for (uint32_t i : tmp) ord[cnt[C.E[i].layer_id]++] = i;
+    std::vector<uint32_t>().swap(tmp);
+    std::vector<uint32_t>().swap(cnt);
+
+    // cut at layer boundaries into a few chunks per worker
+    std::vector<uint32_t> cut { 0 };
+    size_t step = n / (4 * parallel_width(n)) + 1;
+    for (size_t l = 1; l <= L; ++l)
+        if (lstart[l] - cut.back() >= step || l == L) cut.push_back(lstart[l]);
 
-    struct Agg { bool have_p = false, have_m = false; Fp wp, wm; BitVec sp, sm; };
-    std::vector<Agg> acc(L * B);
+    auto nz = [](const Fp& w, const BitVec& s) { return ct::fp_is_nonzero(w) || s.popcnt() != 0; };
 
-    for (const auto& e : C.E) {
-        Agg& a = acc[(size_t)e.layer_id * B + e.idx];
-        if (e.ch == SGN_P) {
-            if (!a.have_p) { a.wp = fp_from_u64(0); a.sp = BitVec::make(pk.prm.m_bits); a.have_p = true; }
-            a.wp = fp_add(a.wp, e.w);
-            a.sp.xor_with(e.s);
-        } else {
-            if (!a.have_m) { a.wm = fp_from_u64(0); a.sm = BitVec::make(pk.prm.m_bits); a.have_m = true; }
-            a.wm = fp_add(a.wm, e.w);
-            a.sm.xor_with(e.s);
+    std::vector<std::vector<Edge>> outs(cut.size() - 1);
+    parallel_for(outs.size(), [&](size_t c, size_t) {
+        std::vector<Edge>& out = outs[c];
+        BitVec t;
+
+        for (uint32_t p = cut[c], end = cut[c + 1]; p < end; ) {
+            Edge& e = C.E[ord[p]];
+            uint32_t q = p + 1;
+            while (q < end && C.E[ord[q]].layer_id == e.layer_id && sub(C.E[ord[q]]) == sub(e)) ++q;
+
+            if (q == p + 1) {
+                if (!e.mat || nz(e.w, e.s)) out.push_back(std::move(e));
+            } else {
+                FpAcc acc;
+                fp_acc_add(acc, e.w);
+                BitVec s = edge_sigma(pk, C, e, t);
+                for (uint32_t r = p + 1; r < q; ++r) {
+                    const Edge& x = C.E[ord[r]];
+                    fp_acc_add(acc, x.w);
+                    s.xor_with(edge_sigma(pk, C, x, t));
+                }
+                Fp w = fp_acc_pos(acc);
+                if (nz(w, s)) out.push_back({e.layer_id, e.idx, e.ch, w, std::move(s)});
+            }
+            p = q;
         }
-    }
+    });
 
-    auto nz = [](const Fp& w, const BitVec& s) { return ct::fp_is_nonzero(w) || s.popcnt() != 0; };
+    size_t total = 0;
+    for (const auto& o : outs) total += o.size();
 
-    std::vector<Edge> out;
-    out.reserve(C.E.size());
-    for (size_t lid = 0; lid < L; lid++) {
-        for (int k = 0; k < B; k++) {
-            Agg& a = acc[lid * (size_t)B + k];
-            if (a.have_p && nz(a.wp, a.sp)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_P, a.wp, a.sp});
-            if (a.have_m && nz(a.wm, a.sm)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_M, a.wm, a.sm});
-        }
+    std::vector<Edge> E;
+    E.reserve(total);
+    for (auto& o : outs) {
+        for (auto& e : o) E.push_back(std::move(e));
+        std::vector<Edge>().swap(o);
     }
-    C.E.swap(out);
+    C.E.swap(E);
+    C.dup_est = 0;
+    C.ix = CipherIndex{};
 }
 
-inline void compact_layers(Cipher& C) {
+// drop layers no edge reaches, returns old -> new ids (UINT32_MAX if dropped).
+// PROD parents sit below their child, so one top-down sweep marks everything
+inline std::vector<uint32_t> compact_layers(Cipher& C) {
     const size_t L = C.L.size();
-    if (L == 0) return;
+    std::vector<uint32_t> remap(L, UINT32_MAX);
+    if (L == 0) return remap;
 
     std::vector<uint8_t> used(L, 0);
     for (const auto& e : C.E) if (e.layer_id < L) used[e.layer_id] = 1;
 
-    for (bool changed = true; changed; ) {
-        changed = false;
-        for (size_t lid = 0; lid < L; ++lid) {
-            if (!used[lid] || C.L[lid].rule != RRule::PROD) continue;
-            auto mark = [&](uint32_t p) { if (p < L && !used[p]) { used[p] = 1; changed = true; } };
-            mark(C.L[lid].pa);
-            mark(C.L[lid].pb);
-        }
+    for (size_t lid = L; lid-- > 0; ) {
+        const Layer& Lr = C.L[lid];
+        if (!used[lid] || Lr.rule != RRule::PROD) continue;
+        if (Lr.pa >= lid || Lr.pb >= lid) std::abort();
+        used[Lr.pa] = 1;
+        used[Lr.pb] = 1;
     }
 
-    std::vector<uint32_t> remap(L, UINT32_MAX);
+    uint32_t n = 0;
+    for (size_t lid = 0; lid < L; ++lid)
+        if (used[lid]) remap[lid] = n++;
+
+    if (n == L) return remap;
+
+    std::vector<Layer> newL;
+    newL.reserve(n);
+    for (size_t lid = 0; lid < L; ++lid) {
+        if (!used[lid]) continue;
+        Layer Lr = C.L[lid];
+        if (Lr.rule == RRule::PROD) { Lr.pa = remap[Lr.pa]; Lr.pb = remap[Lr.pb]; }
+        newL.push_back(Lr);
+    }
+    for (auto& e : C.E) e.layer_id = remap[e.layer_id];
+
+    C.L.swap(newL);
+    C.ix = CipherIndex{};
+    return remap;
+}
+
+// merge identical layers: BASE by seed, PROD by unordered (pa, pb) after the
+// parents are merged. both give the same R, so only edge sigmas care: lazy
+// edges of a PROD layer folded into one with another seed get materialized first
+inline void intern_layers(const PubKey& pk, Cipher& C) {
+    const size_t L = C.L.size();
+    if (L < 2) return;
+
+    std::unordered_map<LayerKey, uint32_t, LayerKeyHash> seen;
+    seen.reserve(L);
+
+    std::vector<uint32_t> remap(L);
     std::vector<Layer> newL;
     newL.reserve(L);
 
-    for (size_t lid = 0; lid < L; ++lid)
-        if (used[lid]) { remap[lid] = (uint32_t)newL.size(); newL.push_back(C.L[lid]); }
+    for (size_t lid = 0; lid < L; ++lid) {
+        Layer Lr = C.L[lid];
+
+        if (Lr.rule == RRule::PROD) {
+            if (Lr.pa >= lid || Lr.pb >= lid) std::abort();
+            Lr.pa = remap[Lr.pa];
+            Lr.pb = remap[Lr.pb];
+            if (Lr.pa > Lr.pb) std::swap(Lr.pa, Lr.pb);
+        }
+
+        auto it = seen.emplace(layer_key(Lr), (uint32_t)newL.size());
+        if (it.second) newL.push_back(Lr);
+        remap[lid] = it.first->second;
+    }
 
     if (newL.size() == L) return;
 
-    for (auto& Lr : newL)
-        if (Lr.rule == RRule::PROD) { Lr.pa = remap[Lr.pa]; Lr.pb = remap[Lr.pb]; }
-    for (auto& e : C.E) e.layer_id = remap[e.layer_id];
+    // edges of a layer that absorbed another one may now share buckets
+    std::vector<uint8_t> nsrc(newL.size(), 0);
+    for (size_t lid = 0; lid < L; ++lid) nsrc[remap[lid]] += nsrc[remap[lid]] < 2;
+
+    std::vector<uint64_t> keys;
+    for (const auto& e : C.E) {
+        uint32_t r = remap[e.layer_id];
+        if (nsrc[r] > 1) keys.push_back(bucket_key(r, e.idx, e.ch));
+    }
+    std::sort(keys.begin(), keys.end());
+    for (size_t i = 1; i < keys.size(); ++i) C.dup_est += keys[i] == keys[i - 1];
+    C.dup_est = std::min(C.dup_est, C.E.size());
+
+    C.ix = CipherIndex{};
+
+    std::vector<size_t> todo;
+    for (size_t i = 0; i < C.E.size(); ++i) {
+        const Edge& e = C.E[i];
+        if (e.mat) continue;
+        const RSeed& a = C.L[e.layer_id].seed;
+        const RSeed& b = newL[remap[e.layer_id]].seed;
+        if (a.ztag != b.ztag || a.nonce.lo != b.nonce.lo || a.nonce.hi != b.nonce.hi) todo.push_back(i);
+    }
+    parallel_for(todo.size(), [&](size_t i, size_t) { materialize_edge(pk, C, C.E[todo[i]]); });
 
+    for (auto& e : C.E) e.layer_id = remap[e.layer_id];
     C.L.swap(newL);
 }
 
+inline size_t cipher_bytes(const Cipher& C) {
+    size_t b = C.L.size() * sizeof(Layer) + C.E.size() * sizeof(Edge);
+    for (const auto& e : C.E) b += e.s.w.size() * sizeof(uint64_t);
+    return b;
+}
+
+struct CompactStats {
+    uint64_t checks = 0;
+    uint64_t runs = 0;
+    uint64_t by_edges = 0;
+    uint64_t by_bytes = 0;
+    uint64_t by_dup = 0;
+    uint64_t edges_in = 0;
+    uint64_t edges_out = 0;
+    double us = 0;
+};
+
+// one guard_budget decision, why is null when it did not compact
+struct CompactEvent {
+    const char* where;
+    const char* why;
+    size_t edges;
+    size_t dup_est;
+    size_t bytes;
+    size_t edges_out;
+    double us;
+};
+
+inline CompactStats g_compact;
+inline std::mutex g_compact_mu;
+
+// every decision is kept in g_compact_log while set, see dump_compact_log
+inline bool g_compact_trace = std::getenv("PVAC_COMPACT_TRACE") != nullptr;
+inline std::vector<CompactEvent> g_compact_log;
+
+inline const char* compact_reason(const Params& p, const Cipher& C, size_t bytes) {
+    size_t n = C.E.size();
+    if (n > p.edge_budget) return "edges";
+    if (bytes > p.compact_max_bytes) return "bytes";
+    if (C.dup_est == 0) return nullptr;
+    if (p.compact_mode == CompactMode::EAGER) return "dup";
+    if (p.compact_mode != CompactMode::ADAPTIVE || (double)C.dup_est < p.compact_dup_ratio * n) return nullptr;
+
+    // each duplicate drops an edge, but a merged bucket of lazy edges comes back
+    // materialized, so only go when the expected byte count goes down
+    size_t nmat = 0;
+    for (const auto& e : C.E) nmat += e.mat;
+    double f = (double)nmat / n;
+    double sig = (double)((p.m_bits + 63) / 64) * sizeof(uint64_t);
+    return sizeof(Edge) + (2 * f - 1) * sig > 0 ? "dup" : nullptr;
+}
+
 inline void guard_budget(const PubKey& pk, Cipher& C, const char* where) {
-    if (C.E.size() > pk.prm.edge_budget) {
-        if (g_dbg) std::cout << "[guard] " << where << ": " << C.E.size() << " -> compact\n";
+    size_t n = C.E.size();
+    size_t bytes = cipher_bytes(C);
+    const char* why = compact_reason(pk.prm, C, bytes);
+
+    CompactEvent ev { where, why, n, C.dup_est, bytes, n, 0.0 };
+
+    if (why) {
+        if (g_dbg > 1 || (g_dbg && why[0] == 'e')) std::cout << "[guard] " << where << ": " << n << " (" << why << ") -> compact\n";
+        auto t0 = std::chrono::steady_clock::now();
         compact_edges(pk, C);
+        ev.us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        ev.edges_out = C.E.size();
+    }
+
+    // encryption runs on workers and pool threads too
+    std::lock_guard<std::mutex> lk(g_compact_mu);
+    ++g_compact.checks;
+
+    if (why) {
+        ++g_compact.runs;
+        g_compact.by_edges += why[0] == 'e';
+        g_compact.by_bytes += why[0] == 'b';
+        g_compact.by_dup += why[0] == 'd';
+        g_compact.edges_in += n;
+        g_compact.edges_out += ev.edges_out;
+        g_compact.us += ev.us;
     }
+
+    if (g_compact_trace) g_compact_log.push_back(ev);
 }
 
 // ndt (new)
-inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
-                          const RSeed& base_seed, uint32_t group_id, uint8_t kind) {
+inline RSeed noise_seed(const RSeed& base_seed, uint32_t group_id, uint8_t kind) {
     RSeed s2 = base_seed;
     uint64_t g = (uint64_t)group_id + 1;
     uint64_t k = (uint64_t)kind + 1;
@@ -125,7 +345,47 @@ inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
     s2.nonce.hi ^= (k << 32);
     s2.ztag ^= (k << 48);
 
-    return prf_R_noise(pk, sk, s2);
+    return s2;
+}
+
+inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
+                          const RSeed& base_seed, uint32_t group_id, uint8_t kind) {
+    return prf_R_noise(pk, sk, noise_seed(base_seed, group_id, kind));
+}
+
+// every prf of one enc_fp_depth in a single parallel pass: R and the deltas of
+// groups 0..z2+z3-2, three prf_R_core tasks each. groups below z2 are kind 0,
+// the rest kind 1, the last group closes the sum to zero. same values as
+// prf_R and prf_noise_delta one by one
+inline Fp enc_prfs(const PubKey& pk, const SecKey& sk, const RSeed& seed,
+                   int z2, int z3, std::vector<Fp>& delta) {
+    if (!g_toep) select_toeplitz();
+
+    size_t G = (size_t)(z2 + z3);
+    size_t m = G > 0 ? G : 1;
+    static const char* const dom_r[3] = { Dom::PRF_R1, Dom::PRF_R2, Dom::PRF_R3 };
+    static const char* const dom_n[3] = { Dom::PRF_NOISE1, Dom::PRF_NOISE2, Dom::PRF_NOISE3 };
+
+    std::vector<Fp> part(3 * m);
+    parallel_for(part.size(), [&](size_t i, size_t) {
+        size_t v = i / 3;
+        if (v == 0) part[i] = prf_R_core(pk, sk, seed, dom_r[i % 3]);
+        else {
+            uint32_t g = (uint32_t)(v - 1);
+            part[i] = prf_R_core(pk, sk, noise_seed(seed, g, g < (uint32_t)z2 ? 0 : 1), dom_n[i % 3]);
+        }
+    });
+
+    auto prod = [&](size_t v) { return fp_mul(fp_mul(part[3 * v], part[3 * v + 1]), part[3 * v + 2]); };
+
+    delta.assign(G, fp_from_u64(0));
+    Fp acc = fp_from_u64(0);
+    for (size_t g = 0; g + 1 < G; g++) {
+        delta[g] = prod(g + 1);
+        acc = fp_add(acc, delta[g]);
+    }
+    if (G) delta[G - 1] = fp_neg(acc);
+    return prod(0);
 }
 
 inline int pick_unique_idx(int B, std::unordered_set<int>& used) {
@@ -149,7 +409,9 @@ inline int pick_distinct_idx2(int B, int ex1, int ex2) {
 
 inline Edge make_edge(uint32_t lid, uint16_t idx, uint8_t ch, Fp w,
                       const PubKey& pk, const RSeed& seed) {
-    return {lid, idx, ch, w, sigma_from_H(pk, seed.ztag, seed.nonce, idx, ch, csprng_u64())};
+    uint64_t salt = csprng_u64();
+    if (pk.prm.lazy_sigma) return {lid, idx, ch, w, BitVec::make(0), salt, false};
+    return {lid, idx, ch, w, sigma_from_H(pk, seed.ztag, seed.nonce, idx, ch, salt), salt, true};
 }
 
 inline void shuffle_edges(std::vector<Edge>& E) {
@@ -159,7 +421,23 @@ inline void shuffle_edges(std::vector<Edge>& E) {
         std::swap(E[i], E[csprng_u64() % (i + 1)]);
 }
 
-inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int depth_hint) {
+// the plaintext only reaches the last share: the weight of the edge at
+// (seed, idx, ch) moves by k per unit of v, everything else is independent of it
+struct EncPatch {
+    RSeed seed;
+    uint16_t idx;
+    uint8_t ch;
+    Fp k;
+};
+
+// 1 / g^i, from powg_inv_B when pk_precompute filled it, else inverted here
+inline Fp powg_inv(const PubKey& pk, int i) {
+    if (pk.powg_inv_B.size() == pk.powg_B.size()) return pk.powg_inv_B[i];
+    return fp_inv(pk.powg_B[i]);
+}
+
+inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int depth_hint,
+                           EncPatch* patch = nullptr) {
     Cipher C;
 
     Layer L;
@@ -188,27 +466,24 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         sumg = sgn_val(ch[j]) > 0 ? fp_add(sumg, term) : fp_sub(sumg, term);
     }
 
-    Fp g_last = pk.powg_B[idx[S-1]];
-    Fp r_last = fp_mul(fp_sub(v, sumg), fp_inv(g_last));
+    Fp inv_last = powg_inv(pk, idx[S-1]);
+    Fp r_last = fp_mul(fp_sub(v, sumg), inv_last);
     r[S-1] = sgn_val(ch[S-1]) < 0 ? fp_neg(r_last) : r_last;
 
-    Fp R = prf_R(pk, sk, L.seed);
+    auto [Z2, Z3] = plan_noise(pk, depth_hint);
+    std::vector<Fp> delta;
+    Fp R = enc_prfs(pk, sk, L.seed, Z2, Z3, delta);
+
+    if (patch) {
+        Fp k = fp_mul(inv_last, R);
+        *patch = EncPatch { L.seed, (uint16_t)idx[S-1], ch[S-1], sgn_val(ch[S-1]) < 0 ? fp_neg(k) : k };
+    }
 
     for (int j = 0; j < S; j++)
         C.E.push_back(make_edge(0, idx[j], ch[j], fp_mul(r[j], R), pk, L.seed));
 
-    auto [Z2, Z3] = plan_noise(pk, depth_hint);
-    int total_groups = Z2 + Z3;
-    Fp delta_acc = fp_from_u64(0);
     int group_id = 0;
 
-    auto next_delta = [&](int groups_left, uint8_t kind) -> Fp {
-        if (groups_left <= 1) return fp_neg(delta_acc);
-        Fp d = prf_noise_delta(pk, sk, L.seed, group_id, kind);
-        delta_acc = fp_add(delta_acc, d);
-        return d;
-    };
-
     for (int t = 0; t < Z2; ++t, ++group_id) {
         int i = csprng_u64() % pk.prm.B;
         int j = pick_distinct_idx(pk.prm.B, i);
@@ -216,12 +491,11 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         uint8_t s1 = csprng_u64() & 1, s2 = s1 ^ 1;
         int sign1 = sgn_val(s1);
 
-        Fp Delta = next_delta(total_groups - group_id, 0);
+        Fp Delta = delta[group_id];
         Fp Delta_prime = sign1 > 0 ? Delta : fp_neg(Delta);
 
-        Fp gi = pk.powg_B[i], gj = pk.powg_B[j];
         Fp r_i = rand_fp_nonzero();
-        Fp r_j = fp_mul(fp_sub(fp_mul(r_i, gi), Delta_prime), fp_inv(gj));
+        Fp r_j = fp_mul(fp_sub(fp_mul(r_i, pk.powg_B[i]), Delta_prime), powg_inv(pk, j));
 
         C.E.push_back(make_edge(0, i, s1, fp_mul(r_i, R), pk, L.seed));
         C.E.push_back(make_edge(0, j, s2, fp_mul(r_j, R), pk, L.seed));
@@ -235,7 +509,7 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         uint8_t s1 = csprng_u64() & 1, s2 = csprng_u64() & 1, s3 = csprng_u64() & 1;
         int sign1 = sgn_val(s1), sign2 = sgn_val(s2), sign3 = sgn_val(s3);
 
-        Fp Delta = next_delta(total_groups - group_id, 1);
+        Fp Delta = delta[group_id];
         Fp a = rand_fp_nonzero(), b = rand_fp_nonzero();
 
         Fp term1 = fp_mul(a, pk.powg_B[i]);
@@ -243,8 +517,9 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         if (sign1 < 0) term1 = fp_neg(term1);
         if (sign2 < 0) term2 = fp_neg(term2);
 
-        Fp gk_signed = sign3 > 0 ? pk.powg_B[k] : fp_neg(pk.powg_B[k]);
-        Fp c = fp_mul(fp_sub(Delta, fp_add(term1, term2)), fp_inv(gk_signed));
+        // 1 / -g = -(1 / g)
+        Fp c = fp_mul(fp_sub(Delta, fp_add(term1, term2)), powg_inv(pk, k));
+        if (sign3 < 0) c = fp_neg(c);
 
         C.E.push_back(make_edge(0, i, s1, fp_mul(a, R), pk, L.seed));
         C.E.push_back(make_edge(0, j, s2, fp_mul(b, R), pk, L.seed));
@@ -272,7 +547,9 @@ inline Cipher combine_ciphers(const PubKey& pk, const Cipher& a, const Cipher& b
 
     for (const auto& e : a.E) C.E.push_back(e);
     for (auto e : b.E) { e.layer_id += off; C.E.push_back(std::move(e)); }
+    C.dup_est = a.dup_est + b.dup_est;
 
+    intern_layers(pk, C);
     guard_budget(pk, C, "combine");
     compact_layers(C);
     return C;
@@ -297,4 +574,53 @@ inline Cipher enc_zero_depth(const PubKey& pk, const SecKey& sk, int depth_hint)
         enc_fp_depth(pk, sk, fp_neg(mask), depth_hint));
 }
 
+// one task per mask half, the prfs of a half then run inline on its worker. a
+// batch with fewer halves than workers goes value by value on the caller
+// instead, so enc_prfs keeps the whole pool. in deterministic mode every half
+// and every combine draws from its own DetTask, the output is the same for
+// any thread count and either path
+inline std::vector<Cipher> enc_values(const PubKey& pk, const SecKey& sk, const uint64_t* v, size_t n,
+                                      int depth_hint = 0) {
+    if (!g_toep) select_toeplitz();
+
+    std::vector<Fp> mask(n);
+    for (auto& m : mask) m = rand_fp_nonzero();
+
+    DetKey dk {};
+    const DetKey* det = nullptr;
+    if (deterministic_rng()) { dk = det_task_key(); det = &dk; }
+
+    auto half = [&](size_t i) {
+        DetTask t(det, i);
+        const Fp& m = mask[i / 2];
+        return enc_fp_depth(pk, sk, (i & 1) ? fp_neg(m) : fp_add(fp_from_u64(v[i / 2]), m), depth_hint);
+    };
+    auto combine = [&](size_t k, const Cipher& a, const Cipher& b) {
+        DetTask t(det, 2 * n + k);
+        return combine_ciphers(pk, a, b);
+    };
+
+    std::vector<Cipher> out(n);
+
+    if (2 * n < parallel_width(SIZE_MAX)) {
+        for (size_t k = 0; k < n; ++k) out[k] = combine(k, half(2 * k), half(2 * k + 1));
+        return out;
+    }
+
+    std::vector<Cipher> hs(2 * n);
+    parallel_for(2 * n, [&](size_t i, size_t) { hs[i] = half(i); });
+
+    parallel_for(n, [&](size_t k, size_t) {
+        out[k] = combine(k, hs[2 * k], hs[2 * k + 1]);
+        std::vector<Edge>().swap(hs[2 * k].E);
+        std::vector<Edge>().swap(hs[2 * k + 1].E);
+    });
+    return out;
+}
+
+inline std::vector<Cipher> enc_values(const PubKey& pk, const SecKey& sk, const std::vector<uint64_t>& v,
+                                      int depth_hint = 0) {
+    return enc_values(pk, sk, v.data(), v.size(), depth_hint);
+}
+
 }
@@ -5,8 +5,10 @@
 #include "pvac/core/random.hpp"
 #include "pvac/core/hash.hpp"
 #include "pvac/core/field.hpp"
+#include "pvac/core/fp_vec.hpp"
 #include "pvac/core/bitvec.hpp"
 #include "pvac/core/types.hpp"
+#include "pvac/core/parallel.hpp"
 
 #include "pvac/crypto/toeplitz.hpp"
 #include "pvac/crypto/matrix.hpp"
@@ -14,6 +16,7 @@
 #include "pvac/crypto/keygen.hpp"
 
 #include "pvac/ops/encrypt.hpp"
+#include "pvac/ops/enc_pool.hpp"
 #include "pvac/ops/decrypt.hpp"
 #include "pvac/ops/arithmetic.hpp"
 #include "pvac/ops/recrypt.hpp"
@@ -21,6 +24,7 @@
 
 #include "pvac/utils/text.hpp"
 #include "pvac/utils/metrics.hpp"
+#include "pvac/utils/serialize.hpp"
 
 namespace pvac {
 
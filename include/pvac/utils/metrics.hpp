@@ -1,10 +1,16 @@
 #pragma once
 
 #include <cstdint>
+#include <array>
+#include <cmath>
+#include <vector>
 #include <fstream>
 #include <iomanip>
+#include <mutex>
 
 #include "../core/types.hpp"
+#include "../core/fp_vec.hpp"
+#include "../core/parallel.hpp"
 #include "../ops/encrypt.hpp"
 #include "../core/ct_safe.hpp"
 
@@ -40,49 +46,93 @@ inline void dump_metrics(
       << val.hi << "\n";
 }
 
-inline double sigma_shannon(const Cipher& C) {
+// guard_budget decisions recorded while g_compact_trace is set, appended to
+// path on every call, the header goes in when the file is new
+inline void dump_compact_log(const char * path = "pvac_compact.csv") {
+    std::ofstream f(path, std::ios::app);
+    if (!f) {
+        return;
+    }
+
+    if (f.tellp() == 0) {
+        f << "where,reason,edges,dup_est,bytes,edges_out,us\n";
+    }
+
+    std::lock_guard<std::mutex> lk(g_compact_mu);
+    for (const auto & ev : g_compact_log) {
+        f << ev.where << ","
+          << (ev.why ? ev.why : "skip") << ","
+          << ev.edges << ","
+          << ev.dup_est << ","
+          << ev.bytes << ","
+          << ev.edges_out << ","
+          << std::fixed << std::setprecision(1) << ev.us << "\n";
+    }
+
+    f.flush();
+    g_compact_log.clear();
+}
+
+inline void reset_compact_stats() {
+    std::lock_guard<std::mutex> lk(g_compact_mu);
+    g_compact = CompactStats{};
+    g_compact_log.clear();
+}
+
+// same sample as sigma_density
+inline double sigma_shannon(const PubKey& pk, const Cipher& C) {
     if (C.E.empty()) return 0.0;
-    
-    std::array<int, 256> freq{};
-    int total = 0;
-    
-    for (const auto& e : C.E) {
-        for (auto w : e.s.w) {
-            for (int i = 0; i < 8; i++) {
-                freq[(w >> (i * 8)) & 0xFF]++;
-                total++;
-            }
+
+    std::vector<uint32_t> ids;
+    std::vector<double> wt;
+    sigma_stat_edges(C, ids, wt);
+
+    std::vector<std::array<double, 256>> freq(parallel_width(ids.size()));
+    for (auto& f : freq) f.fill(0.0);
+
+    parallel_for(ids.size(), [&](size_t i, size_t w) {
+        BitVec tmp;
+        for (auto x : edge_sigma(pk, C, C.E[ids[i]], tmp).w) {
+            for (int b = 0; b < 8; b++) freq[w][(x >> (b * 8)) & 0xFF] += wt[i];
         }
-    }
-    
+    });
+
+    std::array<double, 256> f{};
+    double total = 0;
+    for (const auto& fw : freq)
+        for (int i = 0; i < 256; i++) { f[i] += fw[i]; total += fw[i]; }
+
     if (total == 0) return 0.0;
-    
+
     double H = 0.0;
     for (int i = 0; i < 256; i++) {
-        if (freq[i] > 0) {
-            double p = (double)freq[i] / total;
+        if (f[i] > 0) {
+            double p = f[i] / total;
             H -= p * std::log2(p);
         }
     }
-    return H; 
+    return H;
 }
 
 inline Fp agg_layer_gsum(const PubKey & pk, const Cipher & X, uint32_t lid) {
     Fp s = fp_from_u64(0);
 
+    Fp w[FP_VEC_CHUNK], g[FP_VEC_CHUNK];
+    size_t k = 0;
+
     for (const auto & e : X.E) {
-        if (e.layer_id == lid) {
-            Fp term = fp_mul(e.w, pk.powg_B[e.idx]);
+        if (e.layer_id != lid) continue;
 
-            if (e.ch == SGN_P) {
-                s = fp_add(s, term);
-            } else {
-                s = fp_sub(s, term);
-            }
+        w[k] = e.w;
+        g[k] = e.ch == SGN_P ? pk.powg_B[e.idx] : fp_neg(pk.powg_B[e.idx]);
+
+        if (++k == FP_VEC_CHUNK) {
+            s = fp_muladd_vec(w, g, k, s);
+            k = 0;
         }
     }
 
-    return s;
+    return fp_muladd_vec(w, g, k, s);
 }
 
 inline bool check_mul_gsum_all(
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "../core/types.hpp"
+#include "../crypto/matrix.hpp"
+
+namespace pvac {
+
+// versioned wire format for ciphertexts (little endian)
+//
+// header: magic u32, version u32, canon_tag u64, m_bits u32, nL u32, nE u32
+// layer:  rule u8, ztag u64, nonce lo/hi u64, pa u32, pb u32
+// edge:   layer_id u32, idx u16, ch u8, kind u8, w lo/hi u64,
+//         then salt u64 (kind SEED) or m_bits/64 words (kind RAW)
+//
+// PROD layers keep their seed too, seeded edges on them need it to rebuild sigma
+namespace Wire {
+    inline constexpr uint32_t CT_MAGIC = 0x74637670; // "pvct"
+    inline constexpr uint32_t VER = 2;
+
+    inline constexpr uint8_t RAW = 0;
+    inline constexpr uint8_t SEED = 1;
+}
+
+struct WireOut {
+    std::vector<uint8_t> & b;
+
+    void u8(uint8_t x) { b.push_back(x); }
+
+    void u16(uint16_t x) {
+        b.push_back((uint8_t)x);
+        b.push_back((uint8_t)(x >> 8));
+    }
+
+    void u32(uint32_t x) {
+        for (int i = 0; i < 4; i++) b.push_back((uint8_t)(x >> (8 * i)));
+    }
+
+    void u64(uint64_t x) {
+        size_t n = b.size();
+        b.resize(n + 8);
+        store_le64(b.data() + n, x);
+    }
+};
+
+struct WireIn {
+    const uint8_t * p;
+    size_t n;
+    size_t off = 0;
+    bool ok = true;
+
+    bool need(size_t k) {
+        if (!ok || n - off < k) ok = false;
+        return ok;
+    }
+
+    uint8_t u8() {
+        if (!need(1)) return 0;
+        return p[off++];
+    }
+
+    uint16_t u16() {
+        if (!need(2)) return 0;
+        uint16_t x = (uint16_t)(p[off] | (p[off + 1] << 8));
+        off += 2;
+        return x;
+    }
+
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t x = 0;
+        for (int i = 0; i < 4; i++) x |= (uint32_t)p[off + i] << (8 * i);
+        off += 4;
+        return x;
+    }
+
+    uint64_t u64() {
+        if (!need(8)) return 0;
+        uint64_t x = load_le64(p + off);
+        off += 8;
+        return x;
+    }
+};
+
+// raw = true writes every sigma as bits, otherwise seeded edges are written as their salt
+inline void put_cipher(std::vector<uint8_t> & out, const PubKey & pk, const Cipher & C, bool raw = false) {
+    WireOut o { out };
+    size_t words = ((size_t)pk.prm.m_bits + 63) / 64;
+
+    o.u32(Wire::CT_MAGIC);
+    o.u32(Wire::VER);
+    o.u64(pk.canon_tag);
+    o.u32((uint32_t)pk.prm.m_bits);
+    o.u32((uint32_t)C.L.size());
+    o.u32((uint32_t)C.E.size());
+
+    for (const auto & L : C.L) {
+        o.u8((uint8_t)L.rule);
+        o.u64(L.seed.ztag);
+        o.u64(L.seed.nonce.lo);
+        o.u64(L.seed.nonce.hi);
+        o.u32(L.rule == RRule::PROD ? L.pa : 0);
+        o.u32(L.rule == RRule::PROD ? L.pb : 0);
+    }
+
+    BitVec tmp;
+
+    for (const auto & e : C.E) {
+        bool seeded = !e.mat && !raw;
+
+        o.u32(e.layer_id);
+        o.u16(e.idx);
+        o.u8(e.ch);
+        o.u8(seeded ? Wire::SEED : Wire::RAW);
+        o.u64(e.w.lo);
+        o.u64(e.w.hi);
+
+        if (seeded) {
+            o.u64(e.salt);
+            continue;
+        }
+
+        const BitVec & sg = edge_sigma(pk, C, e, tmp);
+        for (size_t i = 0; i < words; i++) {
+            o.u64(i < sg.w.size() ? sg.w[i] : 0);
+        }
+    }
+}
+
+inline std::vector<uint8_t> ser_cipher(const PubKey & pk, const Cipher & C, bool raw = false) {
+    std::vector<uint8_t> out;
+    put_cipher(out, pk, C, raw);
+    return out;
+}
+
+// false on truncated or malformed input, seeded edges stay seeded unless the key asks for bits
+inline bool get_cipher(WireIn & in, const PubKey & pk, Cipher & C) {
+    if (in.u32() != Wire::CT_MAGIC || in.u32() != Wire::VER) return false;
+    if (in.u64() != pk.canon_tag || in.u32() != (uint32_t)pk.prm.m_bits) return false;
+
+    uint32_t nL = in.u32();
+    uint32_t nE = in.u32();
+    if (!in.ok) return false;
+
+    size_t words = ((size_t)pk.prm.m_bits + 63) / 64;
+
+    // a layer takes 33 bytes and an edge at least 32, so the counts are bounded by the input
+    if ((size_t)nL * 33 + (size_t)nE * 32 > in.n - in.off) return false;
+
+    C.L.assign(nL, Layer{});
+    C.E.clear();
+    C.E.reserve(nE);
+    C.dup_est = 0;
+    C.ix = CipherIndex{};
+
+    for (uint32_t lid = 0; lid < nL; lid++) {
+        Layer & L = C.L[lid];
+        uint8_t rule = in.u8();
+        L.seed.ztag = in.u64();
+        L.seed.nonce.lo = in.u64();
+        L.seed.nonce.hi = in.u64();
+        L.pa = in.u32();
+        L.pb = in.u32();
+
+        if (rule > (uint8_t)RRule::PROD) return false;
+        L.rule = (RRule)rule;
+
+        if (L.rule == RRule::PROD && (L.pa >= lid || L.pb >= lid)) return false;
+    }
+
+    for (uint32_t i = 0; i < nE; i++) {
+        Edge e {};
+        e.layer_id = in.u32();
+        e.idx = in.u16();
+        e.ch = in.u8();
+        uint8_t kind = in.u8();
+        e.w.lo = in.u64();
+        e.w.hi = in.u64();
+
+        if (!in.ok || e.layer_id >= nL || e.idx >= (uint16_t)pk.prm.B || e.ch > SGN_M) return false;
+        if ((e.w.hi >> 63) || (e.w.hi == MASK63 && e.w.lo == UINT64_MAX)) return false;
+
+        if (kind == Wire::SEED) {
+            e.salt = in.u64();
+            e.s = BitVec::make(0);
+            e.mat = false;
+        } else if (kind == Wire::RAW) {
+            if (!in.need(words * 8)) return false;
+            e.s = BitVec::make(pk.prm.m_bits);
+            for (size_t k = 0; k < words; k++) e.s.w[k] = in.u64();
+        } else {
+            return false;
+        }
+
+        C.E.push_back(std::move(e));
+    }
+
+    if (!in.ok) return false;
+
+    // the estimate isn't on the wire, an uncompacted sum still shares buckets
+    std::vector<uint64_t> keys(nE);
+    for (uint32_t i = 0; i < nE; i++) keys[i] = bucket_key(C.E[i].layer_id, C.E[i].idx, C.E[i].ch);
+    std::sort(keys.begin(), keys.end());
+    for (size_t i = 1; i < keys.size(); i++) C.dup_est += keys[i] == keys[i - 1];
+
+    if (!pk.prm.lazy_sigma) {
+        materialize_sigmas(pk, C);
+    }
+
+    return true;
+}
+
+inline bool deser_cipher(const PubKey & pk, const std::vector<uint8_t> & bytes, Cipher & C) {
+    WireIn in { bytes.data(), bytes.size() };
+    return get_cipher(in, pk, C) && in.off == in.n;
+}
+
+inline std::vector<uint8_t> ser_ciphers(const PubKey & pk, const std::vector<Cipher> & cts, bool raw = false) {
+    std::vector<uint8_t> out;
+    WireOut o { out };
+    o.u32((uint32_t)cts.size());
+
+    for (const auto & C : cts) {
+        put_cipher(out, pk, C, raw);
+    }
+
+    return out;
+}
+
+inline bool deser_ciphers(const PubKey & pk, const std::vector<uint8_t> & bytes, std::vector<Cipher> & cts) {
+    WireIn in { bytes.data(), bytes.size() };
+    uint32_t n = in.u32();
+
+    // a cipher header alone is 28 bytes
+    if (!in.ok || (size_t)n * 28 > in.n - in.off) return false;
+
+    cts.assign(n, Cipher{});
+
+    for (auto & C : cts) {
+        if (!get_cipher(in, pk, C)) return false;
+    }
+
+    return in.off == in.n;
+}
+
+}
@@ -197,6 +197,7 @@ auto loadPk = [](const std::string& path) -> PubKey {
 
 
     for (auto& f : pk.powg_B) f = io::getFp(i);
+    pk_precompute(pk);
     return pk;
 };
 
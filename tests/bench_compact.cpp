@@ -0,0 +1,147 @@
+#include <pvac/pvac.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// the old dense L x B table, kept as a reference
+static void compact_edges_dense(const PubKey& pk, Cipher& C) {
+    int B = pk.prm.B;
+    size_t L = C.L.size();
+
+    struct Slot { uint32_t n = 0; size_t first = 0; Fp w; BitVec s; };
+    struct Agg { Slot p, m; };
+    std::vector<Agg> acc(L * B);
+    BitVec tmp;
+
+    for (size_t i = 0; i < C.E.size(); i++) {
+        const Edge& e = C.E[i];
+        Agg& a = acc[(size_t)e.layer_id * B + e.idx];
+        Slot& sl = (e.ch == SGN_P) ? a.p : a.m;
+        if (sl.n++ == 0) { sl.first = i; sl.w = e.w; continue; }
+        if (sl.n == 2) sl.s = edge_sigma(pk, C, C.E[sl.first], tmp);
+        sl.w = fp_add(sl.w, e.w);
+        sl.s.xor_with(edge_sigma(pk, C, e, tmp));
+    }
+
+    auto nz = [](const Fp& w, const BitVec& s) { return ct::fp_is_nonzero(w) || s.popcnt() != 0; };
+
+    std::vector<Edge> out;
+    out.reserve(C.E.size());
+    auto put = [&](Slot& sl, uint32_t lid, int k, uint8_t ch) {
+        if (sl.n == 1) {
+            Edge& e = C.E[sl.first];
+            if (!e.mat || nz(e.w, e.s)) out.push_back(std::move(e));
+        } else if (sl.n > 1 && nz(sl.w, sl.s)) {
+            out.push_back({lid, (uint16_t)k, ch, sl.w, std::move(sl.s)});
+        }
+    };
+    for (size_t lid = 0; lid < L; lid++) {
+        for (int k = 0; k < B; k++) {
+            Agg& a = acc[lid * (size_t)B + k];
+            put(a.p, (uint32_t)lid, k, SGN_P);
+            put(a.m, (uint32_t)lid, k, SGN_M);
+        }
+    }
+    C.E.swap(out);
+}
+
+static long rss_kb() {
+    struct rusage r;
+    getrusage(RUSAGE_SELF, &r);
+    return r.ru_maxrss;
+}
+
+static bool same(const PubKey& pk, const Cipher& a, const Cipher& b) {
+    if (a.E.size() != b.E.size()) return false;
+    BitVec ta, tb;
+    for (size_t i = 0; i < a.E.size(); ++i) {
+        const Edge& x = a.E[i];
+        const Edge& y = b.E[i];
+        if (x.layer_id != y.layer_id || x.idx != y.idx || x.ch != y.ch || !ct::fp_eq(x.w, y.w)) return false;
+        if (!x.mat && !y.mat) {
+            if (x.salt != y.salt) return false;
+            continue;
+        }
+        const BitVec& sx = edge_sigma(pk, a, x, ta);
+        const BitVec& sy = edge_sigma(pk, b, y, tb);
+        if (sx.w != sy.w) return false;
+    }
+    return true;
+}
+
+// L layers, lazy edges on `per` random (idx, ch) buckets of every layer,
+// `dup` of them hit twice so merges build real sigma bits
+static Cipher make_wide(const PubKey& pk, size_t L, int per, int dup) {
+    Cipher C;
+    C.L.resize(L);
+    for (auto& Lr : C.L) {
+        Lr.rule = RRule::BASE;
+        Lr.seed.nonce = make_nonce128();
+        Lr.seed.ztag = prg_layer_ztag(pk.canon_tag, Lr.seed.nonce);
+    }
+    for (uint32_t l = 0; l < L; ++l) {
+        for (int j = 0; j < per; ++j) {
+            uint16_t k = (uint16_t)(csprng_u64() % pk.prm.B);
+            uint8_t ch = (uint8_t)(csprng_u64() & 1);
+            int reps = j < dup ? 2 : 1;
+            for (int r = 0; r < reps; ++r)
+                C.E.push_back({l, k, ch, fp_from_u64(csprng_u64() >> 8), BitVec::make(0), csprng_u64(), false});
+        }
+    }
+    shuffle_edges(C.E);
+    return C;
+}
+
+static void run(const PubKey& pk, const char* name, const Cipher& X) {
+    Cipher A = X, B = X;
+
+    long r0 = rss_kb();
+    auto t0 = Clock::now();
+    compact_edges(pk, A);
+    double ms_new = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    long r1 = rss_kb();
+
+    t0 = Clock::now();
+    compact_edges_dense(pk, B);
+    double ms_old = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    long r2 = rss_kb();
+
+    assert(same(pk, A, B));
+
+    std::cout << name << ": L = " << X.L.size() << " e = " << X.E.size() << " -> " << A.E.size() << "\n"
+              << "  sorted " << std::setw(9) << ms_new << " ms  peak +" << (r1 - r0) / 1024 << " MB\n"
+              << "  dense  " << std::setw(9) << ms_old << " ms  peak +" << (r2 - r1) / 1024 << " MB\n";
+}
+
+int main() {
+    std::cout << "- compact_edges -\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    // real ciphertexts first: the value has to survive compaction
+    Cipher x = enc_value(pk, sk, 11);
+    Cipher s = ct_add(pk, ct_mul(pk, x, x), ct_mul(pk, x, enc_value(pk, sk, 5)));
+    Cipher c = s;
+    compact_edges(pk, c);
+    assert(c.E.size() <= s.E.size());
+    assert(ct::fp_eq(dec_value(pk, sk, c), fp_from_u64(121 + 55)));
+    run(pk, "x*x + x*y", s);
+
+    // sorted runs on wide ciphertexts, the dense table grows with L * B
+    run(pk, "wide 1k", make_wide(pk, 1000, 64, 8));
+    run(pk, "wide 10k", make_wide(pk, 10000, 16, 2));
+
+    std::cout << "PASS\n";
+    return 0;
+}
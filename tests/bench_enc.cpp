@@ -1,6 +1,9 @@
 #include <pvac/pvac.hpp>
 #include <chrono>
 #include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
 
 using namespace pvac;
 using Clock = std::chrono::steady_clock;
@@ -34,6 +37,61 @@ int main() {
     std::cout << "enc_value: " << std::chrono::duration<double>(t1-t0).count() << "s\n";
     std::cout << "edges: " << c.E.size() << "\n";
     std::cout << "layers: " << c.L.size() << "\n";
-    
+
+    // R and the noise deltas of each half are one parallel pass
+    std::cout << "\n- enc_value thread sweep -\n";
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+    const int iters = 8;
+    double t_one = 0;
+    for (int T : {1, 2, 4, 8, 16}) {
+        set_num_threads(T);
+        t0 = Clock::now();
+        for (int i = 0; i < iters; ++i) c = enc_value(pk, sk, i);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / iters;
+        if (T == 1) t_one = ms;
+        std::cout << "  threads " << std::setw(2) << T << ": " << std::fixed << std::setprecision(2)
+                  << std::setw(8) << ms << " ms  x" << t_one / ms << "\n";
+    }
+
+    // whole batches, one task per mask half; a small one goes value by value
+    std::cout << "\n- enc_values -\n";
+    for (size_t nb : {2, 32}) {
+        std::vector<uint64_t> vs(nb);
+        for (size_t i = 0; i < nb; ++i) vs[i] = i * 7919;
+        set_num_threads(1);
+        t0 = Clock::now();
+        for (uint64_t v : vs) c = enc_value(pk, sk, v);
+        double loop_s = std::chrono::duration<double>(Clock::now() - t0).count();
+        std::cout << "  n " << std::setw(2) << nb << " loop of enc_value: " << std::setw(8) << nb / loop_s << " values/s\n";
+        for (int T : {1, 2, 4, 8, 16}) {
+            set_num_threads(T);
+            t0 = Clock::now();
+            std::vector<Cipher> cs = enc_values(pk, sk, vs);
+            double sec = std::chrono::duration<double>(Clock::now() - t0).count();
+            std::cout << "  n " << std::setw(2) << nb << " threads " << std::setw(2) << T << ": "
+                      << std::setw(8) << nb / sec << " values/s\n";
+        }
+    }
+
+    // os generator calls, per-thread drbg against one getrandom per word
+    std::cout << "\n- os rng calls -\n";
+    set_num_threads(1);
+    Cipher a = enc_value(pk, sk, 3), b = enc_value(pk, sk, 5);
+    for (bool drbg : {false, true}) {
+        g_drbg = drbg;
+        uint64_t n0 = g_os_rng_calls.load();
+        t0 = Clock::now();
+        for (int i = 0; i < iters; ++i) c = enc_value(pk, sk, i);
+        double enc_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / iters;
+        uint64_t n1 = g_os_rng_calls.load();
+        t0 = Clock::now();
+        for (int i = 0; i < iters; ++i) c = ct_mul(pk, a, b);
+        double mul_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / iters;
+        uint64_t n2 = g_os_rng_calls.load();
+        std::cout << "  " << (drbg ? "drbg   " : "os only") << ": enc_value " << std::setw(7) << (double)(n1 - n0) / iters
+                  << " calls " << std::setw(7) << enc_ms << " ms, ct_mul " << std::setw(7) << (double)(n2 - n1) / iters
+                  << " calls " << std::setw(7) << mul_ms << " ms\n";
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include <pvac/pvac.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// the old fixpoint marking, kept as a reference
+static void compact_layers_fixpoint(Cipher& C) {
+    const size_t L = C.L.size();
+    if (L == 0) return;
+
+    std::vector<uint8_t> used(L, 0);
+    for (const auto& e : C.E) if (e.layer_id < L) used[e.layer_id] = 1;
+
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t lid = 0; lid < L; ++lid) {
+            if (!used[lid] || C.L[lid].rule != RRule::PROD) continue;
+            auto mark = [&](uint32_t p) { if (p < L && !used[p]) { used[p] = 1; changed = true; } };
+            mark(C.L[lid].pa);
+            mark(C.L[lid].pb);
+        }
+    }
+
+    std::vector<uint32_t> remap(L, UINT32_MAX);
+    std::vector<Layer> newL;
+    for (size_t lid = 0; lid < L; ++lid)
+        if (used[lid]) { remap[lid] = (uint32_t)newL.size(); newL.push_back(C.L[lid]); }
+
+    if (newL.size() == L) return;
+
+    for (auto& Lr : newL)
+        if (Lr.rule == RRule::PROD) { Lr.pa = remap[Lr.pa]; Lr.pb = remap[Lr.pb]; }
+    for (auto& e : C.E) e.layer_id = remap[e.layer_id];
+    C.L.swap(newL);
+}
+
+// nbase BASE layers, then PROD layers; chain = every PROD hangs off the one
+// before it (the fixpoint's worst case), otherwise parents are random.
+// edges land on every stride-th layer and on the last one
+static Cipher make_dag(size_t L, size_t nbase, bool chain, size_t stride) {
+    Cipher C;
+    C.L.resize(L);
+    for (size_t i = 0; i < L; ++i) {
+        Layer& Lr = C.L[i];
+        Lr.seed.nonce = make_nonce128();
+        Lr.seed.ztag = Lr.seed.nonce.lo;
+        if (i < nbase) { Lr.rule = RRule::BASE; continue; }
+        Lr.rule = RRule::PROD;
+        Lr.pa = chain ? (uint32_t)(i - 1) : (uint32_t)(csprng_u64() % i);
+        Lr.pb = chain ? (uint32_t)(i - 1) : (uint32_t)(csprng_u64() % i);
+    }
+
+    auto edge = [&](size_t lid) {
+        C.E.push_back({(uint32_t)lid, (uint16_t)(lid % 337), SGN_P, fp_from_u64(lid + 1), BitVec::make(0), 0, false});
+    };
+    for (size_t i = stride; i < L; i += stride) edge(i);
+    edge(L - 1);
+    return C;
+}
+
+static bool same(const Cipher& a, const Cipher& b) {
+    if (a.L.size() != b.L.size() || a.E.size() != b.E.size()) return false;
+    for (size_t i = 0; i < a.L.size(); ++i) {
+        const Layer& x = a.L[i];
+        const Layer& y = b.L[i];
+        if (x.rule != y.rule || x.seed.nonce.lo != y.seed.nonce.lo) return false;
+        if (x.rule == RRule::PROD && (x.pa != y.pa || x.pb != y.pb)) return false;
+    }
+    for (size_t i = 0; i < a.E.size(); ++i)
+        if (a.E[i].layer_id != b.E[i].layer_id) return false;
+    return true;
+}
+
+static double ms_since(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static void run(const char* name, size_t L, bool chain, size_t stride, bool ref) {
+    Cipher C = make_dag(L, 64, chain, stride);
+    Cipher D = C;
+
+    auto t0 = Clock::now();
+    auto remap = compact_layers(C);
+    double lin = ms_since(t0);
+
+    // the remap table agrees with where the edges went
+    assert(remap.size() == L);
+    for (size_t i = 0; i < C.E.size(); ++i) assert(remap[D.E[i].layer_id] == C.E[i].layer_id);
+    for (size_t i = 0; i < C.L.size(); ++i)
+        if (C.L[i].rule == RRule::PROD) assert(C.L[i].pa < i && C.L[i].pb < i);
+
+    std::cout << name << ": L = " << L << " -> " << C.L.size() << "  linear " << std::setw(8) << lin << " ms";
+
+    if (ref) {
+        t0 = Clock::now();
+        compact_layers_fixpoint(D);
+        double fix = ms_since(t0);
+        assert(same(C, D));
+        std::cout << "  fixpoint " << std::setw(9) << fix << " ms";
+    }
+    std::cout << "\n";
+}
+
+int main() {
+    std::cout << "- compact_layers stress -\n";
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (size_t L : {1000, 10000, 100000}) {
+        run("random", L, false, 97, true);
+        run("chain ", L, true, L, L <= 10000);
+    }
+
+    // nothing to drop: same layers come back with an identity table
+    Cipher C = make_dag(1000, 64, false, 1);
+    auto remap = compact_layers(C);
+    assert(C.L.size() == 1000);
+    for (size_t i = 0; i < remap.size(); ++i) assert(remap[i] == i);
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <pvac/pvac.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static bool same_edges(const Cipher& a, const Cipher& b) {
+    if (a.L.size() != b.L.size() || a.E.size() != b.E.size()) return false;
+    for (size_t i = 0; i < a.E.size(); ++i) {
+        const Edge& x = a.E[i];
+        const Edge& y = b.E[i];
+        if (x.layer_id != y.layer_id || x.idx != y.idx || x.ch != y.ch) return false;
+        if (!ct::fp_eq(x.w, y.w)) return false;
+    }
+    return true;
+}
+
+static void sweep(const PubKey& pk, const SecKey& sk, const char* name,
+                  const Cipher& A, const Cipher& B, Fp want, int iters) {
+    std::cout << name << ": |A| = " << A.E.size() << " |B| = " << B.E.size() << "\n";
+
+    set_num_threads(1);
+    Cipher ref = ct_mul(pk, A, B);
+    assert(ct::fp_eq(dec_value(pk, sk, ref), want));
+
+    double t1 = 0;
+    for (int T : {1, 2, 4, 8, 16, 32, 64}) {
+        set_num_threads(T);
+
+        Cipher C;
+        auto t0 = Clock::now();
+        for (int i = 0; i < iters; ++i) C = ct_mul(pk, A, B);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / iters;
+        if (T == 1) t1 = ms;
+
+        assert(same_edges(ref, C));
+        assert(ct::fp_eq(dec_value(pk, sk, C), want));
+
+        std::cout << "  threads " << std::setw(2) << T << ": " << std::setw(9) << ms << " ms"
+                  << "  x" << t1 / ms << "  edges " << C.E.size() << "\n";
+    }
+}
+
+int main() {
+    std::cout << "- ct_mul thread sweep -\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher X = enc_value(pk, sk, 3);
+    Cipher Y = enc_value(pk, sk, 5);
+    sweep(pk, sk, "fresh x fresh", X, Y, fp_from_u64(15), 5);
+
+    Cipher X2 = ct_mul(pk, X, X);
+    Cipher Y2 = ct_mul(pk, Y, Y);
+    sweep(pk, sk, "deg2 x deg2", X2, Y2, fp_from_u64(225), 1);
+
+    // eager sigmas put the sampling inside ct_mul
+    PubKey pke = pk;
+    pke.prm.lazy_sigma = false;
+    sweep(pke, sk, "fresh x fresh, eager", X, Y, fp_from_u64(15), 1);
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -230,6 +230,7 @@ auto loadPk = [](const std::string& path) -> PubKey {
     pk.powg_B.resize(io::get64(i));
 
     for (auto& f : pk.powg_B) f = io::getFp(i);
+    pk_precompute(pk);
 
 
     return pk;
@@ -274,6 +275,8 @@ int main() {
 
     auto ct_a = enc_value(pk, sk, a);
     auto ct_b = enc_value(pk, sk, b);
+    materialize_sigmas(pk, ct_a);
+    materialize_sigmas(pk, ct_b);
 
     fs::create_directories(dir);
     saveCts({ct_a}, dir + "/a.ct");
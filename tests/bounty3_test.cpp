@@ -224,6 +224,7 @@ PubKey loadPk(const std::string& path) {
     pk.omega_B = io::getFp(i);
     pk.powg_B.resize(io::get64(i));
     for (auto& f : pk.powg_B) f = io::getFp(i);
+    pk_precompute(pk);
     return pk;
 }
 
@@ -267,6 +268,7 @@ int main() {
 
     std::cout << "enc [" << seed.size() << " bytes]\n";
     auto cts = enc_text(pk, sk, seed);
+    for (auto& c : cts) materialize_sigmas(pk, c);
     std::cout << "cts: " << cts.size() << "\n";
 
     fs::create_directories(dir);
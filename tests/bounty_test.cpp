@@ -266,6 +266,7 @@ auto loadPk = [](const std::string& path) -> PubKey {
     pk.powg_B.resize(io::get64(i));
 
     for (auto& f : pk.powg_B) f = io::getFp(i);
+    pk_precompute(pk);
     return pk;
 };
 
@@ -311,6 +312,7 @@ int main() {
     std::cout << "enc seed [" << seed.size() << " bytes]\n";
 
     auto cts = enc_text(pk, sk, seed);
+    for (auto& c : cts) materialize_sigmas(pk, c);
 
     fs::create_directories(dir);
 
@@ -156,6 +156,7 @@ auto loadPk = [](const std::string& path) -> PubKey {
 
     pk.powg_B.resize(io::get64(i));
     for (auto& f : pk.powg_B) f = io::getFp(i);
+    pk_precompute(pk);
 
 
     return pk;
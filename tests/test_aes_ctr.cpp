@@ -4,6 +4,11 @@
 #include <cstring>
 #include <cassert>
 #include <iostream>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
 
 using namespace pvac;
 
@@ -74,6 +79,43 @@ int main() {
     }
     std::cout << "bounded: ok\n";
 
+    // csprng_u64 generator: one os call per seed, not per word
+    {
+        uint64_t c0 = g_os_rng_calls.load();
+        std::unordered_set<uint64_t> seen;
+        for (int i = 0; i < 4096; ++i) seen.insert(csprng_u64());
+        assert(seen.size() == 4096);
+        assert(g_os_rng_calls.load() - c0 <= 1);
+
+        // other threads get their own state
+        std::vector<uint64_t> w(4);
+        std::vector<std::thread> th;
+        for (int t = 0; t < 4; ++t) th.emplace_back([&w, t] { w[t] = csprng_u64(); });
+        for (auto & x : th) x.join();
+        for (uint64_t x : w) assert(seen.insert(x).second);
+        std::cout << "drbg: os calls " << g_os_rng_calls.load() - c0 << " for 4100 words\n";
+    }
+
+    // a forked child must not replay the parent's stream
+    {
+        int fd[2];
+        assert(pipe(fd) == 0);
+        pid_t pid = fork();
+        if (pid == 0) {
+            uint64_t x = csprng_u64();
+            ssize_t r = write(fd[1], &x, 8);
+            _exit(r == 8 ? 0 : 1);
+        }
+        uint64_t mine = csprng_u64(), theirs = 0;
+        assert(read(fd[0], &theirs, 8) == 8);
+        int st = 0;
+        waitpid(pid, &st, 0);
+        close(fd[0]);
+        close(fd[1]);
+        assert(st == 0 && mine != theirs);
+        std::cout << "drbg fork: ok\n";
+    }
+
     std::cout << "PASS\n";
 #else
     std::cout << "skipped (no AES-NI)\n";
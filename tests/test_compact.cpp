@@ -0,0 +1,167 @@
+#include <pvac/pvac.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// edges sharing a bucket with an earlier one
+static size_t count_dups(const Cipher& C) {
+    std::vector<uint64_t> k;
+    k.reserve(C.E.size());
+    for (const auto& e : C.E) k.push_back(((uint64_t)e.layer_id << 32) | (2u * e.idx + e.ch));
+    std::sort(k.begin(), k.end());
+    size_t d = 0;
+    for (size_t i = 1; i < k.size(); ++i) d += k[i] == k[i - 1];
+    return d;
+}
+
+static const char* mode_name(CompactMode m) {
+    return m == CompactMode::LAZY ? "lazy" : m == CompactMode::EAGER ? "eager" : "adaptive";
+}
+
+// acc <- acc + x + x*y, every term lands on layers acc already has.
+// mat: the terms carry built sigmas (as after ubk_apply) instead of salts
+static void chain(PubKey pk, const SecKey& sk, CompactMode mode, bool mat, int steps) {
+    pk.prm.compact_mode = mode;
+    reset_compact_stats();
+
+    Cipher x = enc_value(pk, sk, 3);
+    Cipher y = enc_value(pk, sk, 4);
+    Cipher xy = ct_mul(pk, x, y);
+    if (mat) {
+        materialize_sigmas(pk, x);
+        materialize_sigmas(pk, xy);
+    }
+
+    Cipher acc = ct_add(pk, x, xy);
+    uint64_t want = 15;
+
+    auto t0 = Clock::now();
+    for (int i = 1; i < steps; ++i) {
+        acc = ct_add(pk, ct_add(pk, acc, x), xy);
+        want += 15;
+
+        assert(acc.dup_est >= count_dups(acc));
+    }
+    double op_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    t0 = Clock::now();
+    Fp v = dec_value(pk, sk, acc);
+    double dec_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    assert(ct::fp_eq(v, fp_from_u64(want)));
+
+    std::cout << std::setw(8) << mode_name(mode) << (mat ? " mat " : " lazy") << ": e = " << std::setw(6) << acc.E.size()
+              << " dups = " << std::setw(6) << count_dups(acc) << " est = " << std::setw(6) << acc.dup_est
+              << " kB = " << std::setw(6) << cipher_bytes(acc) / 1024
+              << "  ops " << std::setw(8) << op_ms << " ms  dec " << std::setw(7) << dec_ms << " ms"
+              << "  runs " << g_compact.runs << "/" << g_compact.checks
+              << " (" << g_compact.by_dup << " dup)\n";
+
+    if (mode == CompactMode::LAZY) assert(g_compact.runs == 0);
+    if (mode == CompactMode::EAGER) assert(count_dups(acc) == 0);
+    if (mode == CompactMode::ADAPTIVE) assert(mat ? g_compact.by_dup > 0 : g_compact.runs == 0);
+}
+
+// xor of every sigma, merging buckets leaves it alone
+static BitVec sigma_xor(const PubKey& pk, const Cipher& C) {
+    BitVec acc = BitVec::make(pk.prm.m_bits), t;
+    for (const auto& e : C.E) acc.xor_with(edge_sigma(pk, C, e, t));
+    return acc;
+}
+
+// the same accumulation through ct_add and ct_add_inplace, mostly over
+// layers the sum already has. the last term, a second x*y, only matches by
+// parents and carries salts, so its merges build sigmas
+static void accumulate(const PubKey& pk, const SecKey& sk, int steps) {
+    Cipher x = enc_value(pk, sk, 3);
+    Cipher y = enc_value(pk, sk, 4);
+    Cipher xy[2] = {ct_mul(pk, x, y), ct_mul(pk, x, y)};
+    materialize_sigmas(pk, x);
+    materialize_sigmas(pk, xy[0]);
+
+    std::vector<Cipher> terms;
+    for (int i = 0; i < steps; ++i) {
+        terms.push_back(x);
+        terms.push_back(xy[0]);
+        if (i % 4 == 0) terms.push_back(enc_value(pk, sk, 1));
+    }
+    terms.push_back(xy[1]);
+    uint64_t want = 15 * steps + 12 + (steps + 3) / 4;
+
+    Cipher a = terms[0];
+    auto t0 = Clock::now();
+    for (size_t i = 1; i < terms.size(); ++i) a = ct_add(pk, a, terms[i]);
+    double add_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    Cipher b = terms[0];
+    t0 = Clock::now();
+    for (size_t i = 1; i < terms.size(); ++i) ct_add_inplace(pk, b, terms[i]);
+    double inp_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    assert(b.ix.on && count_dups(b) == 0);
+    assert(ct::fp_eq(dec_value(pk, sk, a), fp_from_u64(want)));
+    assert(ct::fp_eq(dec_value(pk, sk, b), fp_from_u64(want)));
+    assert(sigma_xor(pk, a).w == sigma_xor(pk, b).w);
+
+    Cipher c = a;
+    compact_edges(pk, c);
+    assert(c.E.size() == b.E.size());
+
+    std::cout << "ct_add:         e = " << std::setw(6) << a.E.size() << " L = " << std::setw(4) << a.L.size()
+              << " kB = " << std::setw(6) << cipher_bytes(a) / 1024 << "  " << std::setw(8) << add_ms << " ms\n"
+              << "ct_add_inplace: e = " << std::setw(6) << b.E.size() << " L = " << std::setw(4) << b.L.size()
+              << " kB = " << std::setw(6) << cipher_bytes(b) / 1024 << "  " << std::setw(8) << inp_ms << " ms\n";
+}
+
+int main() {
+    std::cout << "- compaction policy -\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    // products and fresh sums never collide, so the estimate stays at zero
+    Cipher a = ct_add(pk, enc_value(pk, sk, 1), enc_value(pk, sk, 2));
+    Cipher b = ct_mul(pk, a, enc_value(pk, sk, 5));
+    assert(a.dup_est == 0 && b.dup_est == 0);
+
+    // x + x stacks every edge on its twin
+    Cipher x = enc_value(pk, sk, 9);
+    Cipher xx = x;
+    {
+        PubKey lz = pk;
+        lz.prm.compact_mode = CompactMode::LAZY;
+        xx = ct_add(lz, x, x);
+    }
+    assert(xx.dup_est == x.E.size() && count_dups(xx) == x.E.size());
+
+    // adaptive leaves lazy duplicates alone and merges materialized ones
+    for (bool mat : {false, true})
+        for (CompactMode m : {CompactMode::LAZY, CompactMode::ADAPTIVE, CompactMode::EAGER}) chain(pk, sk, m, mat, 16);
+
+    // a byte ceiling forces compaction even in lazy mode
+    PubKey small = pk;
+    small.prm.compact_mode = CompactMode::LAZY;
+    small.prm.compact_max_bytes = cipher_bytes(x);
+    reset_compact_stats();
+    g_compact_trace = true;
+    Cipher z = ct_add(small, x, x);
+    assert(g_compact.by_bytes == 1 && count_dups(z) == 0);
+    assert(g_compact_log.size() == 1 && g_compact_log[0].why);
+    assert(ct::fp_eq(dec_value(pk, sk, z), fp_from_u64(18)));
+    g_compact_trace = false;
+
+    std::cout << "\n- in-place accumulation -\n";
+    accumulate(pk, sk, 64);
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <pvac/pvac.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+int main() {
+    std::cout << "- batched decryption -\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    // a few inputs, many ciphertexts derived from them
+    const uint64_t xs[] = {3, 5, 7, 11};
+    std::vector<Cipher> in;
+    for (uint64_t x : xs) in.push_back(enc_value(pk, sk, x));
+
+    size_t nbase = 0;
+    for (const auto& C : in)
+        for (const auto& L : C.L) nbase += (L.rule == RRule::BASE);
+
+    std::vector<Cipher> cts;
+    std::vector<Fp> want;
+    for (size_t i = 0; i < in.size(); ++i) {
+        for (size_t j = 0; j < in.size(); ++j) {
+            cts.push_back(ct_add(pk, in[i], in[j]));
+            want.push_back(fp_from_u64(xs[i] + xs[j]));
+            cts.push_back(ct_mul(pk, in[i], in[j]));
+            want.push_back(fp_from_u64(xs[i] * xs[j]));
+        }
+    }
+
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < cts.size(); ++i) assert(ct::fp_eq(dec_value(pk, sk, cts[i]), want[i]));
+    auto t1 = Clock::now();
+
+    Decryptor D(pk, sk);
+    std::vector<Fp> got = D.dec_values(cts);
+    auto t2 = Clock::now();
+
+    for (size_t i = 0; i < cts.size(); ++i) assert(ct::fp_eq(got[i], want[i]));
+    assert(D.misses == nbase);
+    assert(D.size() == nbase);
+    std::cout << "batch: ok, " << cts.size() << " ciphertexts, " << nbase << " distinct seeds\n";
+
+    // second pass hits the cache for every seed
+    got = D.dec_values(cts);
+    auto t3 = Clock::now();
+    for (size_t i = 0; i < cts.size(); ++i) assert(ct::fp_eq(got[i], want[i]));
+    assert(D.misses == nbase);
+    assert(D.hits == nbase);
+
+    assert(ct::fp_eq(D.dec_value(cts[1]), want[1]));
+    std::cout << "cache: ok\n";
+
+    // a cache smaller than one batch still decrypts, it only evicts
+    Decryptor S(pk, sk, 2);
+    got = S.dec_values(cts);
+    for (size_t i = 0; i < cts.size(); ++i) assert(ct::fp_eq(got[i], want[i]));
+    assert(S.size() == 2);
+    for (size_t i = 0; i < cts.size(); ++i) assert(ct::fp_eq(S.dec_value(cts[i]), want[i]));
+    assert(S.size() == 2);
+    std::cout << "eviction: ok\n";
+
+    auto ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    std::cout << "dec_value loop " << ms(t0, t1) << " ms, batch cold " << ms(t1, t2)
+              << " ms, batch warm " << ms(t2, t3) << " ms\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -10,12 +10,16 @@ static long long us_diff(const Clock::time_point& a, const Clock::time_point& b)
     return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
 }
 
-static void debug_sigma(const char* label, const Cipher& c) {
+static void debug_sigma(const PubKey& pk, const char* label, const Cipher& c) {
     std::cout << "[debug] " << label << ":\n";
     if (c.E.empty()) { std::cout << "  (no edges)\n"; return; }
     
     size_t popcnt = 0, bits = 0;
-    for (const auto& e : c.E) { popcnt += e.s.popcnt(); bits += e.s.nbits; }
+    BitVec tmp;
+    for (const auto& e : c.E) {
+        const BitVec& s = edge_sigma(pk, c, e, tmp);
+        popcnt += s.popcnt(); bits += s.nbits;
+    }
     
     std::cout << "edges = " << c.E.size() << " layers = " << c.L.size()
               << " popcnt = " << popcnt << " bits = " << bits
@@ -33,43 +37,54 @@ int main() {
 
     csv << "mode, step, edges, layers, balance, sigma_H, mul_us, dec_us, ok\n";
 
-    Cipher c = enc_value(pk, sk, 2);
-    Fp expected = fp_from_u64(2);
+    Cipher c0 = enc_value(pk, sk, 2);
+    debug_sigma(pk, "fresh enc_value(2)", c0);
 
-    debug_sigma("fresh enc_value(2)", c);
-    std::cout << "\n[plain] chain c <- c*c\n";
+    // sqr: c <- c*c through ct_sqr, mul: the same chain through the general product
+    auto chain = [&](const char* mode, int max_steps) {
+        std::cout << "\n[" << mode << "] chain c <- c*c\n";
 
-    constexpr int max_steps = 10;
+        Cipher c = c0;
+        Fp expected = fp_from_u64(2);
 
-    for (int step = 1; step <= max_steps; ++step) {
-        auto t0 = Clock::now();
-        c = ct_mul(pk, c, c);
-        auto t1 = Clock::now();
+        for (int step = 1; step <= max_steps; ++step) {
+            auto t0 = Clock::now();
+            if (mode[0] == 's') {
+                c = ct_sqr(pk, c);
+            } else {
+                Cipher d = c;
+                c = ct_mul(pk, c, d);
+            }
+            auto t1 = Clock::now();
 
-        expected = fp_mul(expected, expected);
+            expected = fp_mul(expected, expected);
 
-        auto t2 = Clock::now();
-        Fp dec = dec_value(pk, sk, c);
-        auto t3 = Clock::now();
+            auto t2 = Clock::now();
+            Fp dec = dec_value(pk, sk, c);
+            auto t3 = Clock::now();
 
-        bool ok = ct::fp_eq(dec, expected);
-        double bal = sigma_density(pk, c);
-        double sH = sigma_shannon(c);
-        long long mul_us = us_diff(t0, t1);
-        long long dec_us = us_diff(t2, t3);
+            bool ok = ct::fp_eq(dec, expected);
+            double bal = sigma_density(pk, c);
+            double sH = sigma_shannon(pk, c);
+            long long mul_us = us_diff(t0, t1);
+            long long dec_us = us_diff(t2, t3);
 
-        if (step == 1) debug_sigma("after first mul", c);
+            if (step == 1) debug_sigma(pk, "after first mul", c);
 
-        std::cout << "step = " << step << " edges = " << c.E.size() << " layers = " << c.L.size()
-                  << " dens = " << bal << " sH = " << sH
-                  << " mul_ms = " << (mul_us / 1000.0) << " dec_ms = " << (dec_us / 1000.0)
-                  << "" << (ok ? " ok" : "FAIL") << "\n";
+            std::cout << "step = " << step << " edges = " << c.E.size() << " layers = " << c.L.size()
+                      << " dens = " << bal << " sH = " << sH
+                      << " mul_ms = " << (mul_us / 1000.0) << " dec_ms = " << (dec_us / 1000.0)
+                      << "" << (ok ? " ok" : "FAIL") << "\n";
 
-        csv << "plain," << step << "," << c.E.size() << "," << c.L.size() << ","
-            << bal << "," << sH << "," << mul_us << "," << dec_us << "," << (ok ? 1 : 0) << "\n";
+            csv << mode << "," << step << "," << c.E.size() << "," << c.L.size() << ","
+                << bal << "," << sH << "," << mul_us << "," << dec_us << "," << (ok ? 1 : 0) << "\n";
 
-        csv.flush();
-    }
+            csv.flush();
+        }
+    };
+
+    chain("mul", 3);
+    chain("sqr", 10);
 
     return 0;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <cmath>
 #include <cassert>
 #include <iostream>
+#include <vector>
+#include <chrono>
 
 using namespace pvac;
 
@@ -37,6 +39,45 @@ static Fp fp_pow_big(Fp a, u128 e) {
     return r;
 }
 
+// schoolbook product and fold-until-small, independent of the kernels
+static Fp ref_mul(const Fp& a, const Fp& b) {
+    u128 p00 = (u128)a.lo * b.lo, p01 = (u128)a.lo * b.hi;
+    u128 p10 = (u128)a.hi * b.lo, p11 = (u128)a.hi * b.hi;
+
+    uint64_t z[4];
+    z[0] = (uint64_t)p00;
+    u128 t = (p00 >> 64) + (uint64_t)p01 + (uint64_t)p10;
+    z[1] = (uint64_t)t;
+    t = (t >> 64) + (p01 >> 64) + (p10 >> 64) + (uint64_t)p11;
+    z[2] = (uint64_t)t;
+    z[3] = (uint64_t)((t >> 64) + (p11 >> 64));
+
+    const u128 P = (((u128)1) << 127) - 1;
+    for (;;) {
+        u128 lo = ((u128)z[1] << 64 | z[0]) & P;
+        u128 hi = ((u128)z[3] << 65) | ((u128)z[2] << 1) | (z[1] >> 63);
+        if (!hi && z[3] < 2) {
+            if (lo >= P) lo -= P;
+            return Fp{(uint64_t)lo, (uint64_t)(lo >> 64)};
+        }
+        u128 s = lo + hi;
+        uint64_t c = s < lo;
+        z[0] = (uint64_t)s;
+        z[1] = (uint64_t)(s >> 64);
+        z[2] = c + (uint64_t)(z[3] >> 63);
+        z[3] = 0;
+    }
+}
+
+// edge values of each limb, the carry chains get exercised there
+static Fp fp_rand_edge() {
+    static const uint64_t lo[] = {0, 1, 2, UINT64_MAX, UINT64_MAX - 1, 1ull << 63};
+    static const uint64_t hi[] = {0, 1, MASK63, MASK63 - 1, 1ull << 62};
+    uint64_t r = csprng_u64();
+    Fp x = fp_from_words(lo[r % 6], hi[(r >> 8) % 5]);
+    return (r >> 16) & 1 ? x : fp_from_words(csprng_u64(), csprng_u64() & MASK63);
+}
+
 int main() {
     std::cout << "- fp core test -\n";
 
@@ -70,6 +111,27 @@ int main() {
     }
     std::cout << "inv: ok\n";
 
+    // divsteps against the exponent chain, zero included
+    for (int i = 0; i < N2; ++i) {
+        Fp a = (i & 1) ? fp_rand_edge() : fp_rand_any();
+        assert(fp_eq(fp_inv_divsteps(a), fp_inv_ct(a)));
+    }
+    for (int k = 0; k < 127; ++k) {
+        Fp a = k < 64 ? Fp{1ull << k, 0} : Fp{0, 1ull << (k - 64)};
+        assert(fp_eq(fp_inv_divsteps(a), fp_inv_ct(a)));
+        Fp b = fp_neg(a);
+        assert(fp_eq(fp_inv_divsteps(b), fp_inv_ct(b)));
+    }
+    std::cout << "inv divsteps: ok\n";
+
+    for (int i = 0; i < N2; ++i) {
+        Fp a = fp_rand_edge();
+        Fp b = fp_rand_edge();
+        assert(fp_eq(fp_mul(a, b), ref_mul(a, b)));
+        assert(fp_eq(fp_sqr(a), ref_mul(a, a)));
+    }
+    std::cout << "mul/sqr vs ref (" << FP_MUL_IMPL << "): ok\n";
+
     const u128 P = (((u128)1) << 127) - 1;
     const int N4 = 2000;
 
@@ -89,6 +151,137 @@ int main() {
     }
     std::cout << "fermat: ok\n";
 
+    for (size_t n : {(size_t)0, (size_t)1, (size_t)2, (size_t)7, (size_t)1000}) {
+        std::vector<Fp> xs(n), a(n), b(n);
+        for (auto& x : xs) x = fp_rand_any();
+        fp_inv_batch(xs.data(), a.data(), n);
+        fp_inv_batch_ct(xs.data(), b.data(), n);
+        for (size_t i = 0; i < n; ++i) {
+            Fp want = fp_inv(xs[i]);
+            assert(fp_eq(a[i], want));
+            assert(fp_eq(b[i], want));
+        }
+
+        // in place
+        std::vector<Fp> c = xs;
+        fp_inv_batch_ct(c.data(), c.data(), n);
+        for (size_t i = 0; i < n; ++i) assert(fp_eq(c[i], b[i]));
+    }
+    std::cout << "inv batch: ok\n";
+
+    {
+        FpAcc acc;
+        Fp want = fp_zero();
+        for (int i = 0; i < 20000; ++i) {
+            Fp a = fp_rand_edge(), b = fp_rand_edge();
+            switch (i & 3) {
+            case 0: fp_acc_muladd(acc, a, b); want = fp_add(want, ref_mul(a, b)); break;
+            case 1: fp_acc_mulsub(acc, a, b); want = fp_sub(want, ref_mul(a, b)); break;
+            case 2: fp_acc_add(acc, a); want = fp_add(want, a); break;
+            default: fp_acc_sub(acc, b); want = fp_sub(want, b); break;
+            }
+        }
+        assert(fp_eq(fp_acc_get(acc), want));
+
+        // largest products, carries reach the fifth word
+        Fp pm1 = fp_neg(fp_one());
+        FpAcc big;
+        for (int i = 0; i < 100000; ++i) fp_acc_muladd(big, pm1, pm1);
+        assert(big.pos[4] != 0);
+        assert(fp_eq(fp_acc_pos(big), fp_from_u64(100000)));
+        assert(fp_eq(fp_acc_get(big), fp_from_u64(100000)));
+    }
+    std::cout << "acc: ok\n";
+
+    // every tail length around the 8-lane blocks, edge limbs mixed in
+    for (size_t n : {0, 1, 7, 8, 9, 15, 16, 17, 63, 64, 65, 1000}) {
+        std::vector<Fp> a(n), b(n), c(n);
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = fp_rand_edge();
+            b[i] = (i & 1) ? fp_rand_edge() : rand_fp_nonzero();
+        }
+        Fp s = fp_rand_edge();
+
+        fp_mul_vec(a.data(), b.data(), c.data(), n);
+        for (size_t i = 0; i < n; ++i) assert(fp_eq(c[i], ref_mul(a[i], b[i])));
+
+        fp_mul_vec(a.data(), s, c.data(), n);
+        for (size_t i = 0; i < n; ++i) assert(fp_eq(c[i], ref_mul(a[i], s)));
+
+        fp_add_vec(a.data(), b.data(), c.data(), n);
+        for (size_t i = 0; i < n; ++i) assert(fp_eq(c[i], fp_add(a[i], b[i])));
+
+        Fp want = s;
+        for (size_t i = 0; i < n; ++i) want = fp_add(want, ref_mul(a[i], b[i]));
+        assert(fp_eq(fp_muladd_vec(a.data(), b.data(), n, s), want));
+
+        // in place
+        c = a;
+        fp_mul_vec(c.data(), b.data(), c.data(), n);
+        for (size_t i = 0; i < n; ++i) assert(fp_eq(c[i], ref_mul(a[i], b[i])));
+    }
+    std::cout << "vec kernels (" << FP_VEC_IMPL << "): ok\n";
+
+    {
+        using Clock = std::chrono::steady_clock;
+        const size_t n = 4096;
+        std::vector<Fp> xs(n), out(n);
+        for (auto& x : xs) x = rand_fp_nonzero();
+
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < n; ++i) out[i] = fp_inv(xs[i]);
+        auto t1 = Clock::now();
+        fp_inv_batch(xs.data(), out.data(), n);
+        auto t2 = Clock::now();
+        fp_inv_batch_ct(xs.data(), out.data(), n);
+        auto t3 = Clock::now();
+
+        auto ns = [&](Clock::time_point a, Clock::time_point b) {
+            return std::chrono::duration<double, std::nano>(b - a).count() / n;
+        };
+        std::cout << "inv ns/elem: single " << ns(t0, t1) << " batch " << ns(t1, t2)
+                  << " batch_ct " << ns(t2, t3) << "\n";
+
+        t0 = Clock::now();
+        for (size_t i = 0; i < n; ++i) out[i] = fp_inv_ct(xs[i]);
+        t1 = Clock::now();
+        for (size_t i = 0; i < n; ++i) out[i] = fp_inv_divsteps(xs[i]);
+        t2 = Clock::now();
+        std::cout << "inv ns: pow " << ns(t0, t1) << " divsteps " << ns(t1, t2) << "\n";
+
+        // dependent chains, so this is latency per op
+        const int R = 1 << 20;
+        Fp x = xs[0], y = xs[1];
+        t0 = Clock::now();
+        for (int i = 0; i < R; ++i) x = fp_mul(x, y);
+        t1 = Clock::now();
+        for (int i = 0; i < R; ++i) y = fp_sqr(y);
+        t2 = Clock::now();
+        volatile uint64_t sink = x.lo ^ y.lo;
+        (void)sink;
+
+        auto ns_op = [&](Clock::time_point a, Clock::time_point b) {
+            return std::chrono::duration<double, std::nano>(b - a).count() / R;
+        };
+        std::cout << FP_MUL_IMPL << " ns/op: mul " << ns_op(t0, t1) << " sqr " << ns_op(t1, t2) << "\n";
+
+        // independent lanes, so this is throughput per element
+        std::vector<Fp> ys(n);
+        for (auto& v : ys) v = rand_fp_nonzero();
+        Fp acc = fp_zero();
+        t0 = Clock::now();
+        for (size_t i = 0; i < n; ++i) out[i] = fp_mul(xs[i], ys[i]);
+        for (size_t i = 0; i < n; ++i) acc = fp_add(acc, fp_mul(xs[i], ys[i]));
+        t1 = Clock::now();
+        fp_mul_vec(xs.data(), ys.data(), out.data(), n);
+        acc = fp_muladd_vec(xs.data(), ys.data(), n, acc);
+        t2 = Clock::now();
+        sink = acc.lo ^ out[n - 1].lo;
+
+        std::cout << FP_VEC_IMPL << " ns/elem (mul + muladd): scalar " << ns(t0, t1)
+                  << " vec " << ns(t1, t2) << "\n";
+    }
+
     std::cout << "PASS\n";
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <pvac/pvac.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static size_t count_rule(const Cipher& C, RRule r) {
+    size_t n = 0;
+    for (const auto& L : C.L) n += (L.rule == r);
+    return n;
+}
+
+static bool seeds_unique(const Cipher& C) {
+    for (size_t i = 0; i < C.L.size(); ++i) {
+        for (size_t j = i + 1; j < C.L.size(); ++j) {
+            const Layer& a = C.L[i];
+            const Layer& b = C.L[j];
+            if (a.rule != b.rule) continue;
+            if (a.rule == RRule::BASE) {
+                if (a.seed.nonce.lo == b.seed.nonce.lo && a.seed.nonce.hi == b.seed.nonce.hi) return false;
+            } else {
+                if (std::min(a.pa, a.pb) == std::min(b.pa, b.pb) && std::max(a.pa, a.pb) == std::max(b.pa, b.pb)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void show(const PubKey& pk, const SecKey& sk, const char* name, const Cipher& C, uint64_t want) {
+    auto t0 = Clock::now();
+    Fp v = dec_value(pk, sk, C);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    std::cout << name << ": L = " << C.L.size() << " (base " << count_rule(C, RRule::BASE)
+              << ", prod " << count_rule(C, RRule::PROD) << ") e = " << C.E.size()
+              << " dec = " << ms << " ms\n";
+
+    assert(ct::fp_eq(v, fp_from_u64(want)));
+    assert(seeds_unique(C));
+}
+
+int main() {
+    std::cout << "- layer interning -\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher x = enc_value(pk, sk, 6);
+    Cipher y = enc_value(pk, sk, 7);
+
+    // x*x + x*y: x's base layers appear in both terms
+    Cipher xx = ct_mul(pk, x, x);
+    Cipher xy = ct_mul(pk, x, y);
+    Cipher s = ct_add(pk, xx, xy);
+    show(pk, sk, "x*x + x*y", s, 36 + 42);
+    assert(count_rule(s, RRule::BASE) == count_rule(xy, RRule::BASE));
+
+    // the same product built twice: its prod layers merge too
+    Cipher xy2 = ct_mul(pk, x, y);
+    Cipher d = ct_add(pk, xy, xy2);
+    show(pk, sk, "x*y + x*y", d, 84);
+    assert(d.L.size() == xy.L.size());
+
+    // x*(x+y) pairs x's layers with themselves in both orders
+    Cipher m = ct_mul(pk, x, ct_add(pk, x, y));
+    show(pk, sk, "x*(x+y)", m, 6 * 13);
+
+    Cipher p = ct_add(pk, ct_mul(pk, s, x), ct_mul(pk, xx, x));
+    show(pk, sk, "(x*x + x*y)*x + x*x*x", p, 78 * 6 + 216);
+
+    // merged layers survive the wire format and keep their commitments
+    auto cm = commit_ct(pk, d);
+    Cipher r;
+    bool ok = deser_cipher(pk, ser_cipher(pk, d), r);
+    assert(ok);
+    assert(commit_ct(pk, r) == cm);
+    assert(ct::fp_eq(dec_value(pk, sk, r), fp_from_u64(84)));
+
+    // interning is idempotent
+    Cipher q = p;
+    intern_layers(pk, q);
+    assert(q.L.size() == p.L.size() && q.E.size() == p.E.size());
+
+    std::cout << "PASS\n";
+    return 0;
+}
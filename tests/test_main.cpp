@@ -54,11 +54,12 @@ double w_ent(const Cipher& c) {
     return shannon(freq, (int)c.E.size());
 }
 
-double s_byte_ent(const Cipher& c) {
+double s_byte_ent(const PubKey& pk, const Cipher& c) {
     std::map<uint64_t, int> freq;
     int total = 0;
+    BitVec tmp;
     for (const auto& e : c.E) {
-        for (auto w : e.s.w) {
+        for (auto w : edge_sigma(pk, c, e, tmp).w) {
             for (int i = 0; i < 8; i++) {
                 freq[(w >> (i * 8)) & 0xFF]++;
                 total++;
@@ -68,19 +69,21 @@ double s_byte_ent(const Cipher& c) {
     return shannon(freq, total);
 }
 
-double avg_s_hw(const Cipher& c) {
+double avg_s_hw(const PubKey& pk, const Cipher& c) {
     if (c.E.empty()) return 0.0;
     double sum = 0.0;
-    for (const auto& e : c.E) sum += hw_bv(e.s);
+    BitVec tmp;
+    for (const auto& e : c.E) sum += hw_bv(edge_sigma(pk, c, e, tmp));
     return sum / c.E.size();
 }
 
-double bit_bal(const Cipher& c) 
+double bit_bal(const PubKey& pk, const Cipher& c) 
 {
     uint64_t ones = 0, total = 0;
+    BitVec tmp;
 
     for (const auto& e : c.E) {
-        for (auto w : e.s.w) {
+        for (auto w : edge_sigma(pk, c, e, tmp).w) {
             ones += hw64(w);
             total += 64;
         }
@@ -88,13 +91,14 @@ double bit_bal(const Cipher& c)
     return total > 0 ? (double)ones / total : 0.5;
 }
 
-double ct_corr(const Cipher& c1, const Cipher& c2) {
+double ct_corr(const PubKey& pk, const Cipher& c1, const Cipher& c2) {
     size_t n = std::min(c1.E.size(), c2.E.size());
     if (n == 0) return 0.0;
     double sum = 0.0;
+    BitVec t1, t2;
     for (size_t i = 0; i < n; i++) {
-        const auto& s1 = c1.E[i].s;
-        const auto& s2 = c2.E[i].s;
+        const auto& s1 = edge_sigma(pk, c1, c1.E[i], t1);
+        const auto& s2 = edge_sigma(pk, c2, c2.E[i], t2);
         size_t m = std::min(s1.w.size(), s2.w.size());
         int xor_hw = 0;
         for (size_t j = 0; j < m; j++) xor_hw += hw64(s1.w[j] ^ s2.w[j]);
@@ -127,11 +131,11 @@ size_t ct_mem(const Cipher& c) {
 
 
 
-void pr_analysis(const std::string& name, const Cipher& c) {
+void pr_analysis(const PubKey& pk, const std::string& name, const Cipher& c) {
     std::cout << "" << name << ": e = " << c.E.size() << " L = " << c.L.size() 
 
-              << "bal = " << std::fixed << std::setprecision(2) << bit_bal(c)
-              << "s_ent = " << s_byte_ent(c) << " mem = " << ct_mem(c) << "b\n";
+              << "bal = " << std::fixed << std::setprecision(2) << bit_bal(pk, c)
+              << "s_ent = " << s_byte_ent(pk, c) << " mem = " << ct_mem(c) << "b\n";
 }
 
 template<typename F>
@@ -161,6 +165,16 @@ int main() {
         std::cout << "H = 0x" << hex8(pk.H_digest.data(), 8) << " m = " << pk.prm.m_bits 
                 << " n = " << pk.prm.n_bits << " B = " << pk.prm.B << "\n\n";
 
+    must(pk.powg_inv_B.size() == pk.powg_B.size(), "powg_inv_B size", &pk);
+    for (size_t i = 0; i < pk.powg_B.size(); ++i)
+        must(ct::fp_is_one(fp_mul(pk.powg_B[i], pk.powg_inv_B[i])), "powg_inv_B", &pk);
+    {
+        // a key loaded without pk_precompute still encrypts
+        PubKey bare = pk;
+        bare.powg_inv_B.clear();
+        must(ct::fp_eq(dec_value(bare, sk, enc_value(bare, sk, 99)), fp_from_u64(99)), "enc without powg_inv_B", &bare);
+    }
+
     EvalKey ek = make_evalkey(pk, sk, 32, 3);
 
     uint64_t x = 2016733, y = 7083881, z = 13579;
@@ -175,6 +189,25 @@ int main() {
         must(dec_value(pk, sk, Zc).lo == z, "dec(Z)", &pk, &Zc);
     std::cout << "dec ok\n";
 
+    {
+        std::vector<uint64_t> vs = { x, y, z, 0, 1, ~0ull };
+        std::vector<Cipher> cs = enc_values(pk, sk, vs);
+        must(cs.size() == vs.size(), "enc_values size", &pk);
+        for (size_t i = 0; i < vs.size(); ++i)
+            must(ct::fp_eq(dec_value(pk, sk, cs[i]), fp_from_u64(vs[i])), "enc_values", &pk, &cs[i]);
+        must(enc_values(pk, sk, nullptr, 0).empty(), "enc_values empty", &pk);
+
+        // fewer halves than workers, one value at a time on the caller
+        int t0 = get_num_threads();
+        set_num_threads(16);
+        std::vector<Cipher> cs2 = enc_values(pk, sk, vs.data(), 2);
+        set_num_threads(t0);
+        must(cs2.size() == 2, "enc_values small size", &pk);
+        for (size_t i = 0; i < 2; ++i)
+            must(ct::fp_eq(dec_value(pk, sk, cs2[i]), fp_from_u64(vs[i])), "enc_values small", &pk, &cs2[i]);
+    }
+    std::cout << "batch enc ok\n";
+
     Cipher S = ct_add(pk, X, Y);
     must(dec_value(pk, sk, S).lo == x + y, "add", &pk, &S);
 
@@ -185,6 +218,31 @@ int main() {
     u128 prod = (u128)x * (u128)y;
     Fp expP = fp_from_words((uint64_t)prod, (uint64_t)(prod >> 64) & MASK63);
     must(ct::fp_eq(dec_value(pk, sk, P), expP), "mul", &pk, &P);
+
+    std::vector<Fp> T = layer_gsums(pk, P);
+    for (uint32_t l = 0; l < (uint32_t)P.L.size(); ++l)
+        must(ct::fp_eq(T[l], agg_layer_gsum(pk, P, l)), "layer gsums", &pk, &P);
+
+    {
+        // repeated adds of one input leave duplicates apart, shuffled for good measure
+        Cipher A = X;
+        for (int i = 0; i < 6; ++i) A = ct_add(pk, A, X);
+        for (int i = 0; i < 4; ++i) A = ct_sub(pk, A, X);
+        shuffle_edges(A.E);
+        std::vector<Fp> TA = layer_gsums(pk, A);
+        for (uint32_t l = 0; l < (uint32_t)A.L.size(); ++l)
+            must(ct::fp_eq(TA[l], agg_layer_gsum(pk, A, l)), "layer gsums shuffled", &pk, &A);
+        must(ct::fp_eq(dec_value(pk, sk, A), fp_mul(fp_from_u64(3), fp_from_u64(x))), "dec shuffled", &pk, &A);
+    }
+    {
+        // sampled lazy sigmas against every sigma rebuilt
+        long double ones = 0;
+        BitVec tmp;
+        for (const auto& e : P.E) ones += edge_sigma(pk, P, e, tmp).popcnt();
+        double exact = (double)(ones / ((long double)P.E.size() * pk.prm.m_bits));
+        must(std::fabs(sigma_density(pk, P) - exact) < 0.002, "sigma_density sample", &pk, &P);
+        must(std::fabs(sigma_shannon(pk, P) - 8.0) < 0.01, "sigma_shannon sample", &pk, &P);
+    }
     std::cout << "add / sub / mul ok\n";
 
     std::cout << "\n- edge cases -\n";
@@ -205,6 +263,26 @@ int main() {
     Cipher wrap = ct_add(pk, neg_one, C1);
     must(dec_value(pk, sk, wrap).lo == 0, "(p - 1) + 1 = 0", &pk, &wrap);
     std::cout << "modular wrap ok\n";
+
+    // 200k-layer square chain on one BASE layer, R of layer k is R0^(2^k)
+    {
+        const uint32_t depth = 200000;
+        Cipher deep;
+        deep.L = { X.L[0] };
+        deep.L.reserve(depth + 1);
+        for (uint32_t l = 1; l <= depth; ++l) {
+            Layer Lr;
+            Lr.rule = RRule::PROD;
+            Lr.pa = Lr.pb = l - 1;
+            deep.L.push_back(Lr);
+        }
+
+        Fp R = prf_R(pk, sk, X.L[0].seed);
+        for (uint32_t l = 0; l < depth; ++l) R = fp_sqr(R);
+        deep.E.push_back({depth, 0, SGN_P, fp_mul(R, fp_from_u64(7)), BitVec::make(pk.prm.m_bits)});
+        must(dec_value(pk, sk, deep).lo == 7, "deep prod chain", &pk);
+    }
+    std::cout << "deep prod chain ok\n";
     std::cout << "\n- extra : 30 random ops \n";
     std::vector<Cipher> pool;
     pool.push_back(enc_value(pk, sk, g_rng() % 100 + 1));
@@ -275,15 +353,15 @@ int main() {
 
     std::cout << "\n- corr test -\n";
     Cipher X_copy = enc_value(pk, sk, x);
-    double corr = ct_corr(X, X_copy);
+    double corr = ct_corr(pk, X, X_copy);
     std::cout << "corr(enc(x), enc(x)) = " << corr << " (exp ~ " << pk.prm.m_bits / 2 << ")\n";
     must(X.E[0].w.lo != X_copy.E[0].w.lo, "diff rnd", &pk, &X_copy);
 
     std::cout << "\n- recrypt -\n";
     Cipher X3 = ct_mul(pk, ct_mul(pk, X, X), X);
-    std::cout << "before: bal = " << bit_bal(X3) << " s_ent = " << s_byte_ent(X3) << " L = " << X3.L.size() << "\n";
+    std::cout << "before: bal = " << bit_bal(pk, X3) << " s_ent = " << s_byte_ent(pk, X3) << " L = " << X3.L.size() << "\n";
     Cipher U = ct_recrypt(pk, ek, X3);
-    std::cout << "after:  bal = " << bit_bal(U) << " s_ent = " << s_byte_ent(U) << " L = " << U.L.size() << "\n";
+    std::cout << "after:  bal = " << bit_bal(pk, U) << " s_ent = " << s_byte_ent(pk, U) << " L = " << U.L.size() << "\n";
     must(ct::fp_eq(dec_value(pk, sk, U), dec_value(pk, sk, X3)), "recrypt", &pk, &U);
 
     std::cout << "\n- chain 2^10 -\n";
@@ -292,7 +370,7 @@ int main() {
     for (int i = 1; i < N; i++) chain = ct_mul(pk, chain, enc_value(pk, sk, 2));
     must(dec_value(pk, sk, chain).lo == (1ULL << N), "2^10", &pk, &chain);
     std::cout << "2^10 = " << (1ULL << N) << " ok\n";
-    pr_analysis("chain", chain);
+    pr_analysis(pk, "chain", chain);
 
     std::cout << "\n- chain with recrypt -\n";
     const int REC_INT = 3;
@@ -304,7 +382,7 @@ int main() {
     }
     must(dec_value(pk, sk, chain_r).lo == (1ULL << N), "2^10 rec", &pk, &chain_r);
     std::cout << "recrypt calls = " << rec_cnt << "\n";
-    pr_analysis("chain_r", chain_r);
+    pr_analysis(pk, "chain_r", chain_r);
 
     std::cout << "\n- 10! -\n";
     Cipher fact = enc_value(pk, sk, 1);
@@ -362,10 +440,10 @@ int main() {
     
     // analysis
     
-    pr_analysis("X (fresh)", X);
-    pr_analysis("P (X * Y)", P);
-    pr_analysis("X3 (X^3)", X3);
-    pr_analysis("fact (10!)", fact);
+    pr_analysis(pk, "X (fresh)", X);
+    pr_analysis(pk, "P (X * Y)", P);
+    pr_analysis(pk, "X3 (X^3)", X3);
+    pr_analysis(pk, "fact (10!)", fact);
     ///
 
     std::cout << "\n- text -\n";
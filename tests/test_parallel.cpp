@@ -0,0 +1,157 @@
+#include <pvac/pvac.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// every index once, worker ids below the width, nested loops inline
+static void cover(size_t n) {
+    std::vector<std::atomic<int>> hit(n);
+    std::atomic<size_t> maxw { 0 };
+    std::atomic<bool> nested_ok { true };
+    size_t W = parallel_width(n);
+
+    parallel_for(n, [&](size_t i, size_t w) {
+        hit[i]++;
+        size_t m = maxw.load();
+        while (w > m && !maxw.compare_exchange_weak(m, w)) {}
+        if (W > 1) parallel_for(3, [&](size_t, size_t w2) { if (w2 != 0) nested_ok = false; });
+    });
+
+    for (auto & h : hit) assert(h == 1);
+    assert(n == 0 || maxw < W);
+    assert(nested_ok);
+}
+
+int main() {
+    std::cout << "- parallel test -\n";
+
+    for (int T : {1, 2, 3, 8}) {
+        set_num_threads(T);
+        for (size_t n : {0, 1, 2, 7, 1000, 100000}) cover(n);
+    }
+    std::cout << "cover: ok\n";
+
+    // one uneven task, the rest of its slice is stolen
+    {
+        set_num_threads(4);
+        std::vector<std::atomic<int>> hit(64);
+        parallel_for(hit.size(), [&](size_t i, size_t) {
+            if (i == 0) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            hit[i]++;
+        });
+        for (auto & h : hit) assert(h == 1);
+    }
+    std::cout << "steal: ok\n";
+
+    // callers on other threads run inline while the pool is taken
+    {
+        auto body = [](int seed) {
+            for (int it = 0; it < 2000; ++it) {
+                size_t n = (size_t)(it * seed) % 97 + 1;
+                std::vector<std::atomic<int>> hit(n);
+                parallel_for(n, [&](size_t i, size_t) { hit[i]++; });
+                for (auto & h : hit) assert(h == 1);
+            }
+        };
+        std::thread a(body, 7), b(body, 13);
+        body(3);
+        a.join();
+        b.join();
+    }
+    std::cout << "concurrent callers: ok\n";
+
+    {
+        assert(parallel_width(100) == 4);
+        assert(parallel_width(100, ExecPolicy { 2 }) == 2);
+        {
+            ExecScope s(exec_seq);
+            assert(parallel_width(100) == 1);
+        }
+        assert(parallel_width(100) == 4);
+    }
+    std::cout << "policy: ok\n";
+
+    // a throw on any worker reaches the caller, the pool stays usable
+    for (size_t bad : {0, 13, 999}) {
+        set_num_threads(4);
+        bool caught = false;
+        try {
+            parallel_for(1000, [&](size_t i, size_t) { if (i == bad) throw std::runtime_error("x"); });
+        } catch (const std::runtime_error &) {
+            caught = true;
+        }
+        assert(caught);
+        assert(parallel_width(100) == 4);
+        cover(1000);
+    }
+    std::cout << "exceptions: ok\n";
+
+    // a child has none of the parent's workers
+    {
+        pid_t pid = fork();
+        if (pid == 0) {
+            std::atomic<size_t> s { 0 };
+            parallel_for(1000, [&](size_t i, size_t) { s += i; });
+            _exit(s == 999 * 1000 / 2 ? 0 : 1);
+        }
+        int st = 1;
+        waitpid(pid, &st, 0);
+        assert(WIFEXITED(st) && WEXITSTATUS(st) == 0);
+    }
+    std::cout << "fork: ok\n";
+
+    // fork while other threads keep the pool busy, the child must not hang
+    {
+        std::atomic<bool> stop { false };
+        std::vector<std::thread> bg;
+        for (int t = 0; t < 3; ++t)
+            bg.emplace_back([&] { while (!stop) parallel_for(4, [](size_t, size_t) {}); });
+        for (int k = 0; k < 300; ++k) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                std::atomic<size_t> s { 0 };
+                parallel_for(1000, [&](size_t i, size_t) { s += i; });
+                _exit(s == 999 * 1000 / 2 ? 0 : 1);
+            }
+            int st = 1;
+            auto t0 = Clock::now();
+            while (waitpid(pid, &st, WNOHANG) == 0) {
+                if (Clock::now() - t0 > std::chrono::seconds(10)) {
+                    kill(pid, SIGKILL);
+                    waitpid(pid, &st, 0);
+                    std::cerr << "fork under load: child hung\n";
+                    return 1;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            assert(WIFEXITED(st) && WEXITSTATUS(st) == 0);
+        }
+        stop = true;
+        for (auto & t : bg) t.join();
+    }
+    std::cout << "fork under load: ok\n";
+
+    for (int T : {1, 2, 4}) {
+        set_num_threads(T);
+        std::atomic<size_t> s { 0 };
+        auto t0 = Clock::now();
+        for (int i = 0; i < 2000; ++i) parallel_for(16, [&](size_t k, size_t) { s += k; });
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / 2000;
+        std::cout << "threads " << T << ": parallel_for(16) " << us << " us\n";
+    }
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include <pvac/pvac.hpp>
+
+#include <cstdint>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static bool same_edges(const Cipher& a, const Cipher& b) {
+    if (a.L.size() != b.L.size() || a.E.size() != b.E.size()) return false;
+    for (size_t i = 0; i < a.E.size(); ++i) {
+        const Edge& x = a.E[i];
+        const Edge& y = b.E[i];
+        if (x.layer_id != y.layer_id || x.idx != y.idx || x.ch != y.ch) return false;
+        if (!ct::fp_eq(x.w, y.w)) return false;
+    }
+    return true;
+}
+
+static void report(const PubKey& pk, const char* name, const Cipher& C, int iters) {
+    double ser_us[2] = {0, 0}, de_us[2] = {0, 0};
+    size_t bytes[2] = {0, 0};
+
+    for (int raw = 0; raw < 2; ++raw) {
+        std::vector<uint8_t> buf;
+        auto t0 = Clock::now();
+        for (int i = 0; i < iters; ++i) buf = ser_cipher(pk, C, raw != 0);
+        auto t1 = Clock::now();
+
+        Cipher D;
+        for (int i = 0; i < iters; ++i) {
+            bool ok = deser_cipher(pk, buf, D);
+            assert(ok);
+        }
+        auto t2 = Clock::now();
+
+        bytes[raw] = buf.size();
+        ser_us[raw] = std::chrono::duration<double, std::micro>(t1 - t0).count() / iters;
+        de_us[raw] = std::chrono::duration<double, std::micro>(t2 - t1).count() / iters;
+    }
+
+    auto mbs = [](size_t b, double us) { return us > 0 ? b / us : 0.0; };
+
+    std::cout << name << ": e = " << C.E.size() << " L = " << C.L.size() << "\n"
+              << "  seed: " << bytes[0] << " B  ser " << ser_us[0] << " us (" << mbs(bytes[0], ser_us[0])
+              << " MB/s)  deser " << de_us[0] << " us (" << mbs(bytes[0], de_us[0]) << " MB/s)\n"
+              << "  raw:  " << bytes[1] << " B  ser " << ser_us[1] << " us (" << mbs(bytes[1], ser_us[1])
+              << " MB/s)  deser " << de_us[1] << " us (" << mbs(bytes[1], de_us[1]) << " MB/s)\n"
+              << "  ratio = " << (double)bytes[1] / bytes[0] << "\n";
+}
+
+int main() {
+    std::cout << "- serialize test -\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher X = enc_value(pk, sk, 1234567);
+    Cipher Y = enc_value(pk, sk, 7654321);
+    Cipher P = ct_mul(pk, X, Y);
+    Cipher U = P;
+    ubk_apply(pk, U);
+
+    for (const Cipher* C : {&X, &P, &U}) {
+        Fp v = dec_value(pk, sk, *C);
+        auto cm = commit_ct(pk, *C);
+
+        for (int raw = 0; raw < 2; ++raw) {
+            auto buf = ser_cipher(pk, *C, raw != 0);
+            Cipher D;
+            bool ok = deser_cipher(pk, buf, D);
+            assert(ok);
+            assert(same_edges(*C, D));
+            assert(ct::fp_eq(dec_value(pk, sk, D), v));
+            assert(commit_ct(pk, D) == cm);
+        }
+    }
+    std::cout << "roundtrip: ok\n";
+
+    // an uncompacted sum keeps its duplicate estimate across the wire
+    {
+        PubKey lk = pk;
+        lk.prm.compact_mode = CompactMode::LAZY;
+        Cipher S = ct_add(lk, X, X);
+        assert(S.dup_est > 0);
+        Cipher D;
+        bool ok = deser_cipher(lk, ser_cipher(lk, S), D);
+        assert(ok);
+        assert(D.dup_est > 0);
+        assert(ct::fp_eq(dec_value(lk, sk, D), dec_value(lk, sk, S)));
+    }
+    std::cout << "dup_est: ok\n";
+
+    std::vector<Cipher> cts = enc_text(pk, sk, "wire format");
+    std::vector<Cipher> cts2;
+    bool ok = deser_ciphers(pk, ser_ciphers(pk, cts), cts2);
+    assert(ok);
+    assert(dec_text(pk, sk, cts2) == "wire format");
+    std::cout << "batch: ok\n";
+
+    auto buf = ser_cipher(pk, P);
+    Cipher D;
+    for (size_t cut : {(size_t)0, (size_t)7, buf.size() / 2, buf.size() - 1}) {
+        std::vector<uint8_t> t(buf.begin(), buf.begin() + cut);
+        assert(!deser_cipher(pk, t, D));
+    }
+
+    std::vector<uint8_t> bad = buf;
+    bad[4] ^= 1;
+    assert(!deser_cipher(pk, bad, D));
+
+    PubKey pk2 = pk;
+    pk2.canon_tag ^= 1;
+    assert(!deser_cipher(pk2, buf, D));
+    std::cout << "reject: ok\n";
+
+    // same seed, same key and same bytes
+    {
+        auto run = [](uint64_t seed) {
+            set_deterministic_rng(seed);
+            Params p2;
+            PubKey k;
+            SecKey s;
+            keygen(p2, k, s);
+            Cipher a = enc_value(k, s, 11), b = enc_value(k, s, 13);
+            std::vector<uint8_t> out = ser_cipher(k, ct_mul(k, a, b));
+            clear_deterministic_rng();
+            return out;
+        };
+        auto r1 = run(7), r2 = run(7), r3 = run(8);
+        assert(r1 == r2);
+        assert(r1 != r3);
+        assert(!deterministic_rng());
+    }
+    std::cout << "deterministic rng: ok\n";
+
+    // parallel loops keep their threads, enc_values still repeats byte for byte
+    {
+        auto run = [](int T, size_t n) {
+            set_num_threads(T);
+            set_deterministic_rng(21);
+            assert(parallel_width(100) == (size_t)T);
+            Params p2;
+            PubKey k;
+            SecKey s;
+            keygen(p2, k, s);
+            std::vector<uint64_t> vs(n);
+            for (size_t i = 0; i < n; ++i) vs[i] = 1000 + i;
+            std::vector<Cipher> cs = enc_values(k, s, vs);
+            std::vector<uint8_t> out = ser_ciphers(k, cs);
+            std::vector<uint8_t> prod = ser_cipher(k, ct_mul(k, cs[0], cs[n - 1]));
+            out.insert(out.end(), prod.begin(), prod.end());
+            clear_deterministic_rng();
+            return out;
+        };
+        int t0 = get_num_threads();
+        for (size_t n : {1, 8}) {
+            auto a = run(1, n);
+            assert(run(4, n) == a);
+            assert(run(16, n) == a);
+        }
+        set_num_threads(t0);
+    }
+    std::cout << "deterministic threads: ok\n";
+
+    std::cout << "\n- size / throughput -\n";
+    report(pk, "fresh", X, 50);
+    report(pk, "product", P, 5);
+    report(pk, "ubk", U, 5);
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -62,7 +62,7 @@ static void run_scenario(const ScenarioCfg& cfg, int scenario_id,
 
         csv << cfg.label << "," << scenario_id << "," << step << ","
             << acc.E.size() << "," << acc.L.size() << ","
-            << sigma_density(pk, acc) << "," << sigma_shannon(acc) << ","
+            << sigma_density(pk, acc) << "," << sigma_shannon(pk, acc) << ","
             << us_diff(t0, t1) << "," << us_diff(t2, t3) << ","
             << (ct::fp_eq(dec, val) ? 1 : 0) << "\n";
     }